@@ -1,4 +1,9 @@
 #include "cpu/cpu_gemm.h"
+#include "cpu/cpu_cache.h"
+#include "cpu/cpu_tune.h"
+#include "cpu/cpu_context.h"
+#include "cpu/cpu_alloc.h"
+#include "cpu/cpu_jit.h"
 #include "gpu/gpu.h"
 #include "gpu/gpu_gemm.h"
 #include <stdio.h>
@@ -27,6 +32,17 @@ int check(dtype_t* c, dtype_t* correct, uint32_t n_rows, uint32_t n_columns) {
 	return 0;
 }
 
+// max |c - reference| relative to max |reference|
+double max_relative_error(dtype_t* c, dtype_t* reference, uint32_t n_rows, uint32_t n_columns) {
+	uint32_t len = n_rows * n_columns;
+	double error = 0, norm = 0;
+	for(uint32_t i = 0; i < len; i++) {
+		error = fmax(error, fabs((double)c[i] - reference[i]));
+		norm = fmax(norm, fabs((double)reference[i]));
+	}
+	return norm ? error / norm : error;
+}
+
 void print_matrix(dtype_t* m, uint32_t n_rows, uint32_t n_columns) {
 	for(uint32_t i = 0; i < n_rows; i++) {
 		for(uint32_t j = 0; j < n_columns; j++) {
@@ -81,6 +97,7 @@ typedef struct {
 	int quiet;
 	int check;
 	void (*f)(void*, dtype_t*, dtype_t*, dtype_t*, uint32_t, uint32_t, uint32_t);
+	void* userdata; // passed to f: a GemmContext for the CPU kernels, the GPUData for the GPU
 	GPUData gpu;
 } EvaluationSuite;
 
@@ -89,7 +106,7 @@ int evaluate(EvaluationSuite* suite, double* time) {
 	memset(suite->C, 0x00, suite->ni * suite->nj * sizeof(dtype_t));
 
 	double start = omp_get_wtime();
-	suite->f(&suite->gpu, suite->C, suite->A, suite->B, suite->ni, suite->nj, suite->nk);
+	suite->f(suite->userdata, suite->C, suite->A, suite->B, suite->ni, suite->nj, suite->nk);
 	double stop = omp_get_wtime();
 	*time = stop - start;
 
@@ -109,15 +126,97 @@ int evaluate(EvaluationSuite* suite, double* time) {
 	return 0;
 }
 
+// the product of the suite in double precision through gemm_blas_f64 (beta 0,
+// so without clearing C), checked against the fp32 result when the suite checks
+int evaluate_f64(EvaluationSuite* suite, double* time) {
+	size_t size_a = (size_t)suite->ni * suite->nk, size_b = (size_t)suite->nk * suite->nj, size_c = (size_t)suite->ni * suite->nj;
+	double* A = cpu_alloc(size_a * sizeof(double));
+	double* B = cpu_alloc(size_b * sizeof(double));
+	double* C = cpu_alloc(size_c * sizeof(double));
+	int failed = !A || !B || !C;
+	if(failed) {
+		error("out of memory\n");
+		goto defer;
+	}
+	for(size_t i = 0; i < size_a; i++) A[i] = suite->A[i];
+	for(size_t i = 0; i < size_b; i++) B[i] = suite->B[i];
+
+	double start = omp_get_wtime();
+	// B is column major, the row major B^T
+	gemm_blas_f64(suite->userdata, GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_TRANS, suite->ni, suite->nj, suite->nk, 1, A, suite->nk, B, suite->nk, 0, C, suite->nj);
+	*time = omp_get_wtime() - start;
+
+	for(size_t i = 0; suite->check && i < size_c; i++) {
+		if(fabs(C[i] - suite->correct[i]) > 0.001) {
+			printf("C matrix is wrong for [%s]: correct[%zu] != C[%zu] (%f != %f)\n", suite->name, i, i, suite->correct[i], C[i]);
+			failed = 1;
+			goto defer;
+		}
+	}
+	if(!suite->quiet) {
+		printf("\t[%s]: %.2es\n", suite->name, *time);
+	}
+defer:
+	cpu_free(A);
+	cpu_free(B);
+	cpu_free(C);
+	return failed;
+}
+
+// the product of the suite with A and B stored in bf16 or fp16 (f16 set) through
+// gemm_blas_bf16 / gemm_blas_f16, converted before the timed call like a caller
+// keeping its operands in 16 bits would have them. The suite values are exact
+// in both formats, so the fp32 result is checked like the other kernels
+int evaluate_16bit(EvaluationSuite* suite, int f16, double* time) {
+	size_t size_a = (size_t)suite->ni * suite->nk, size_b = (size_t)suite->nk * suite->nj;
+	uint16_t* A = cpu_alloc(size_a * sizeof(uint16_t));
+	uint16_t* B = cpu_alloc(size_b * sizeof(uint16_t));
+	int failed = !A || !B;
+	if(failed) {
+		error("out of memory\n");
+		goto defer;
+	}
+	if(f16) {
+		cpu_f16_from_f32(A, suite->A, size_a);
+		cpu_f16_from_f32(B, suite->B, size_b);
+	} else {
+		cpu_bf16_from_f32(A, suite->A, size_a);
+		cpu_bf16_from_f32(B, suite->B, size_b);
+	}
+
+	double start = omp_get_wtime();
+	// B is column major, the row major B^T
+	if(f16) {
+		gemm_blas_f16(suite->userdata, GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_TRANS, suite->ni, suite->nj, suite->nk, 1, A, suite->nk, B, suite->nk, 0, suite->C, suite->nj);
+	} else {
+		gemm_blas_bf16(suite->userdata, GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_TRANS, suite->ni, suite->nj, suite->nk, 1, A, suite->nk, B, suite->nk, 0, suite->C, suite->nj);
+	}
+	*time = omp_get_wtime() - start;
+
+	int error_index = 0;
+	if(suite->check && (error_index = check(suite->C, suite->correct, suite->ni, suite->nj))) {
+		printf("C matrix is wrong for [%s]: correct[%u] != C[%u] (%f != %f)\n", suite->name, error_index, error_index, suite->correct[error_index], suite->C[error_index]);
+		failed = 1;
+		goto defer;
+	}
+	if(!suite->quiet) {
+		printf("\t[%s]: %.2es\n", suite->name, *time);
+	}
+defer:
+	cpu_free(A);
+	cpu_free(B);
+	return failed;
+}
+
 EvaluationSuite createSuite(uint32_t ni, uint32_t nj, uint32_t nk, int check) {	
 	EvaluationSuite suite = {
 		.ni = ni,
 		.nj = nj,
 		.nk = nk,
-		.correct = malloc(ni * nj * sizeof(dtype_t)),
+		.correct = cpu_alloc(ni * nj * sizeof(dtype_t)),
 		.C = NULL,
-		.A = malloc(ni * nk * sizeof(dtype_t)),
-		.B = malloc(nk * nj * sizeof(dtype_t)),
+		.A = cpu_alloc(ni * nk * sizeof(dtype_t)),
+		.B = cpu_alloc(nk * nj * sizeof(dtype_t)),
 		.name = "NAIVE",
 		.check = 0,
 		.f = gemm_rrc_naive
@@ -133,19 +232,389 @@ EvaluationSuite createSuite(uint32_t ni, uint32_t nj, uint32_t nk, int check) {
 		evaluate(&suite, &tmp);
 	}
 	suite.check = check;
-	suite.C = malloc(ni * nj * sizeof(dtype_t));
+	suite.C = cpu_alloc(ni * nj * sizeof(dtype_t));
 	suite.gpu = initGPUData();
 	return suite;
 }
 
 void freeSuite(EvaluationSuite suite) {
-	free(suite.correct);
-	free(suite.C);
-	free(suite.A);
-	free(suite.B);
+	cpu_free(suite.correct);
+	cpu_free(suite.C);
+	cpu_free(suite.A);
+	cpu_free(suite.B);
 	freeGPUData(suite.gpu);
 }
 
+// gemm_compute behind the common signature, B was packed before the timing
+typedef struct {
+	GemmContext* ctx;
+	GemmPackedB* packed;
+} PrepackedB;
+
+void gemm_rrc_prepacked(void* userdata, dtype_t* C, dtype_t* A, dtype_t* _, uint32_t ni, uint32_t nj, uint32_t nk) {
+	PrepackedB* prepacked = userdata;
+	(void)_, (void)nj, (void)nk;
+	gemm_compute(prepacked->ctx, C, A, prepacked->packed, ni);
+}
+
+// gemm_rtt_tiled behind the common signature, A and B were tiled before the timing
+typedef struct {
+	GemmContext* ctx;
+	TiledMatrix* A;
+	TiledMatrix* B;
+} TiledOperands;
+
+void gemm_rtt_tiled_operands(void* userdata, dtype_t* C, dtype_t* _A, dtype_t* _B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	TiledOperands* tiled = userdata;
+	(void)_A, (void)_B, (void)ni, (void)nj, (void)nk;
+	gemm_rtt_tiled(tiled->ctx, C, tiled->A, tiled->B);
+}
+
+// gemv_c behind the common signature, A was made column major before the timing
+typedef struct {
+	GemmContext* ctx;
+	dtype_t* A;
+} ColumnMajorA;
+
+void gemv_c_operands(void* userdata, dtype_t* C, dtype_t* _A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	ColumnMajorA* operands = userdata;
+	(void)_A, (void)nj;
+	gemv_c(operands->ctx, C, operands->A, B, ni, nk);
+}
+
+// gemm_blas_f32 behind the common signature, C += A B
+void gemm_rrc_blas_f32(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	gemm_blas_f32(userdata, GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_TRANS, ni, nj, nk, 1, A, nk, B, nk, 1, C, nj);
+}
+
+// gemm --gemv: matrix-vector products (nj == 1) through the full BLIS machinery
+// and through the GEMV kernels gemm_rrc routes them to, as bandwidth over A
+int createGemvReport(void) {
+	GemmContext* ctx = cpu_context_create(0);
+	double time = 0.0;
+	int failed = 0;
+	for(uint32_t n = 512; n <= 8192 && !failed; n *= 2) {
+		EvaluationSuite suite = createSuite(n, 1, n, 1);
+		suite.userdata = ctx;
+		suite.quiet = 1;
+		double bytes = (double)n * n * sizeof(dtype_t);
+		printf("%u x %u (%.1f MiB):\n", n, n, bytes / (1 << 20));
+
+		suite.f = gemm_rrc_blis_avx;
+		suite.name = "BLIS (6x16 MICRO-KERNEL & AVX)";
+		if(!(failed = evaluate(&suite, &time))) {
+			printf("\t[%s]: %.2es, %.2f GB/s\n", suite.name, time, bytes / time * 1e-9);
+		}
+
+		suite.f = gemm_rrc;
+		suite.name = "DEFAULT (GEMV, ROW MAJOR A)";
+		if(!failed && !(failed = evaluate(&suite, &time))) {
+			printf("\t[%s]: %.2es, %.2f GB/s\n", suite.name, time, bytes / time * 1e-9);
+		}
+
+		ColumnMajorA operands = {
+			.ctx = ctx,
+			.A = cpu_alloc(bytes),
+		};
+		if(!failed && operands.A) {
+			memcpy(operands.A, suite.A, bytes);
+			convert_row_major_to_column_major(operands.A, n, n);
+			suite.f = gemv_c_operands;
+			suite.userdata = &operands;
+			suite.name = "GEMV, COLUMN MAJOR A";
+			if(!(failed = evaluate(&suite, &time))) {
+				printf("\t[%s]: %.2es, %.2f GB/s\n", suite.name, time, bytes / time * 1e-9);
+			}
+		}
+		cpu_free(operands.A);
+		freeSuite(suite);
+	}
+	cpu_context_destroy(ctx);
+	return failed;
+}
+
+// gemm --shapes: the threaded kernels on a square C, a short and wide one, a
+// tall and skinny one, a rank-k update and a small C with a huge nk, in GFLOP/s.
+// The last line of each is gemm_rrc in the reproducible mode
+int createShapesReport(void) {
+	static const uint32_t shapes[][3] = {
+		{ 2048, 2048, 2048 },
+		{ 64, 8192, 4096 },
+		{ 8192, 64, 4096 },
+		{ 4096, 4096, 8 },
+		{ 128, 128, 262144 },
+	};
+	static const struct {
+		char* name;
+		void (*f)(void*, dtype_t*, dtype_t*, dtype_t*, uint32_t, uint32_t, uint32_t);
+		int reproducible;
+	} kernels[] = {
+		{ "BLOCKED & PACKING & AVX (RRC with reduction) & OMP", gemm_rrc_blocked_avx_and_omp, 0 },
+		{ "BLIS (6x16 MICRO-KERNEL & AVX)", gemm_rrc_blis_avx, 0 },
+		{ "BLIS & OMP (SHAPE-AWARE)", gemm_rrc_blis_omp, 0 },
+		{ "DEFAULT (REPRODUCIBLE)", gemm_rrc, 1 },
+	};
+	GemmContext* ctx = cpu_context_create(0);
+	double time = 0.0;
+	int failed = 0;
+	for(uint32_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]) && !failed; s++) {
+		uint32_t ni = shapes[s][0], nj = shapes[s][1], nk = shapes[s][2];
+		EvaluationSuite suite = createSuite(ni, nj, nk, 0);
+		suite.userdata = ctx;
+		suite.quiet = 1;
+		printf("%u x %u x %u:\n", ni, nj, nk);
+		for(uint32_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]) && !failed; k++) {
+			suite.f = kernels[k].f;
+			suite.name = kernels[k].name;
+			cpu_context_set_reproducible(ctx, kernels[k].reproducible);
+			if(!(failed = evaluate(&suite, &time))) {
+				printf("\t[%s]: %.2es, %.2f GFLOP/s\n", suite.name, time, 2.0 * ni * nj * nk / time * 1e-9);
+			}
+		}
+		freeSuite(suite);
+	}
+	cpu_context_destroy(ctx);
+	return failed;
+}
+
+// copy of the (rows, cols) matrix m (row major) stored as op(X) = m in the
+// given layout, i.e. as m^T when transposed, with a stride of ld
+void store_matrix(dtype_t* dst, dtype_t* m, uint32_t rows, uint32_t cols, GemmLayout layout, GemmTranspose trans, uint32_t ld) {
+	for(uint32_t r = 0; r < rows; r++) {
+		for(uint32_t c = 0; c < cols; c++) {
+			uint32_t x = trans == GEMM_TRANS ? c : r, y = trans == GEMM_TRANS ? r : c;
+			dst[layout == GEMM_ROW_MAJOR ? (size_t)x * ld + y : (size_t)y * ld + x] = m[(size_t)r * cols + c];
+		}
+	}
+}
+
+// gemm --layouts: gemm_blas on every combination of layout and transposes (C
+// overwritten with beta 0, no copies), against transposing the operands into
+// the layout of gemm_rrc, clearing C and transposing C back as before. The
+// last line is a view of the middle of C, A and B
+int createLayoutsReport(void) {
+	const uint32_t n = 1024;
+	EvaluationSuite suite = createSuite(n, n, n, 0);
+	size_t bytes = (size_t)n * n * sizeof(dtype_t);
+	dtype_t* B = cpu_alloc(bytes); // row major
+	dtype_t* A_stored = cpu_alloc(bytes);
+	dtype_t* B_stored = cpu_alloc(bytes);
+	dtype_t* reference = cpu_alloc(bytes);
+	GemmContext* ctx = cpu_context_create(0);
+	int failed = !B || !A_stored || !B_stored || !reference || !suite.C;
+	if(failed) {
+		error("out of memory\n");
+	} else {
+		memcpy(B, suite.B, bytes);
+		convert_column_major_to_row_major(B, n, n);
+		memset(reference, 0x00, bytes);
+		gemm_rrc(ctx, reference, suite.A, suite.B, n, n, n);
+	}
+	for(uint32_t combination = 0; combination < 8 && !failed; combination++) {
+		GemmLayout layout = combination & 4 ? GEMM_COL_MAJOR : GEMM_ROW_MAJOR;
+		GemmTranspose trans_a = combination & 2 ? GEMM_TRANS : GEMM_NO_TRANS;
+		GemmTranspose trans_b = combination & 1 ? GEMM_TRANS : GEMM_NO_TRANS;
+		printf("%s, A%s, B%s:\n", layout == GEMM_ROW_MAJOR ? "row major" : "column major", trans_a == GEMM_TRANS ? "^T" : "", trans_b == GEMM_TRANS ? "^T" : "");
+		store_matrix(A_stored, suite.A, n, n, layout, trans_a, n);
+		store_matrix(B_stored, B, n, n, layout, trans_b, n);
+
+		// stored in the layout of gemm_rrc when A is read along its rows and B
+		// along its columns
+		int a_rows = (layout == GEMM_ROW_MAJOR) != (trans_a == GEMM_TRANS);
+		int b_columns = (layout == GEMM_ROW_MAJOR) == (trans_b == GEMM_TRANS);
+		double start = omp_get_wtime();
+		if(!a_rows) {
+			convert_column_major_to_row_major(A_stored, n, n);
+		}
+		if(!b_columns) {
+			convert_row_major_to_column_major(B_stored, n, n);
+		}
+		memset(suite.C, 0x00, bytes);
+		gemm_rrc(ctx, suite.C, A_stored, B_stored, n, n, n);
+		if(layout == GEMM_COL_MAJOR) {
+			convert_row_major_to_column_major(suite.C, n, n);
+		}
+		double time = omp_get_wtime() - start;
+		printf("\t[TRANSPOSES & MEMSET & DEFAULT]: %.2es\n", time);
+
+		store_matrix(A_stored, suite.A, n, n, layout, trans_a, n);
+		store_matrix(B_stored, B, n, n, layout, trans_b, n);
+		start = omp_get_wtime();
+		gemm_blas(ctx, layout, trans_a, trans_b, n, n, n, 1, A_stored, n, B_stored, n, 0, suite.C, n);
+		time = omp_get_wtime() - start;
+		if(layout == GEMM_COL_MAJOR) {
+			convert_column_major_to_row_major(suite.C, n, n);
+		}
+		double error = max_relative_error(suite.C, reference, n, n);
+		if((failed = error > 1e-5)) {
+			printf("C matrix is wrong for [BLAS-STYLE]: max relative error %.2e\n", error);
+		} else {
+			printf("\t[BLAS-STYLE]: %.2es\n", time);
+		}
+	}
+	if(!failed) {
+		// the middle (n/2, n/2) of C from the middle rows of A and columns of B
+		uint32_t m = n / 2, offset = n / 4;
+		printf("row major views, (%u, %u) of (%u, %u):\n", m, m, n, n);
+		double start = omp_get_wtime();
+		gemm_blas(ctx, GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, m, n, 1, &suite.A[(size_t)offset * n], n, &B[offset], n, 0, &suite.C[(size_t)offset * n + offset], n);
+		double time = omp_get_wtime() - start;
+		double error = 0, norm = 0;
+		for(uint32_t i = offset; i < offset + m; i++) {
+			for(uint32_t j = offset; j < offset + m; j++) {
+				error = fmax(error, fabs((double)suite.C[i * n + j] - reference[i * n + j]));
+				norm = fmax(norm, fabs((double)reference[i * n + j]));
+			}
+		}
+		if((failed = error > 1e-5 * norm)) {
+			printf("C matrix is wrong for [BLAS-STYLE]: max relative error %.2e\n", error / norm);
+		} else {
+			printf("\t[BLAS-STYLE]: %.2es\n", time);
+		}
+	}
+	cpu_context_destroy(ctx);
+	cpu_free(B);
+	cpu_free(A_stored);
+	cpu_free(B_stored);
+	cpu_free(reference);
+	freeSuite(suite);
+	return failed;
+}
+
+// gemm --accuracy: gemm_rrc_blis_omp against gemm_rrc_blis_compensated on a
+// small C with deep nk, as the max error relative to a double precision
+// reference. The operands are in [0, 1], so the rounding errors of the plain
+// accumulation don't cancel and grow with nk
+int createAccuracyReport(void) {
+	static const uint32_t depths[] = { 4096, 65536, 1 << 20 };
+	static const struct {
+		char* name;
+		void (*f)(void*, dtype_t*, dtype_t*, dtype_t*, uint32_t, uint32_t, uint32_t);
+	} kernels[] = {
+		{ "BLIS & OMP (SHAPE-AWARE)", gemm_rrc_blis_omp },
+		{ "BLIS & OMP (COMPENSATED)", gemm_rrc_blis_compensated },
+	};
+	const uint32_t ni = 32, nj = 32;
+	GemmContext* ctx = cpu_context_create(0);
+	int failed = 0;
+	for(uint32_t d = 0; d < sizeof(depths) / sizeof(depths[0]) && !failed; d++) {
+		uint32_t nk = depths[d];
+		dtype_t* A = cpu_alloc((size_t)ni * nk * sizeof(dtype_t));
+		dtype_t* B = cpu_alloc((size_t)nk * nj * sizeof(dtype_t));
+		dtype_t* C = cpu_alloc((size_t)ni * nj * sizeof(dtype_t));
+		double* reference = malloc((size_t)ni * nj * sizeof(double));
+		if(!A || !B || !C || !reference) {
+			error("out of memory\n");
+			failed = 1;
+		}
+		for(size_t i = 0; !failed && i < (size_t)ni * nk; i++) A[i] = (dtype_t)rand() / RAND_MAX;
+		for(size_t i = 0; !failed && i < (size_t)nk * nj; i++) B[i] = (dtype_t)rand() / RAND_MAX;
+		for(uint32_t i = 0; !failed && i < ni; i++) {
+			for(uint32_t j = 0; j < nj; j++) {
+				double sum = 0;
+				for(uint32_t k = 0; k < nk; k++) sum += (double)A[(size_t)i * nk + k] * B[(size_t)j * nk + k];
+				reference[i * nj + j] = sum;
+			}
+		}
+		if(!failed) {
+			printf("%u x %u x %u:\n", ni, nj, nk);
+		}
+		for(uint32_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]) && !failed; k++) {
+			memset(C, 0x00, (size_t)ni * nj * sizeof(dtype_t));
+			double start = omp_get_wtime();
+			kernels[k].f(ctx, C, A, B, ni, nj, nk);
+			double time = omp_get_wtime() - start;
+			double error = 0;
+			for(uint32_t i = 0; i < ni * nj; i++) {
+				error = fmax(error, fabs(C[i] - reference[i]) / reference[i]);
+			}
+			printf("\t[%s]: %.2es, max relative error %.2e\n", kernels[k].name, time, error);
+		}
+		cpu_free(A);
+		cpu_free(B);
+		cpu_free(C);
+		free(reference);
+	}
+	cpu_context_destroy(ctx);
+	return failed;
+}
+
+// fp32 against the int8 kernels on the same real values: A quantized to u8
+// with a zero point, B to s8 with one scale per column (output channel). The
+// error of the int8 results against fp32 is the quantization error
+int createInt8Report(void) {
+	static const uint32_t sizes[] = { 256, 1024, 2048 };
+	GemmContext* ctx = cpu_context_create(0);
+	int failed = 0;
+	for(uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && !failed; s++) {
+		uint32_t n = sizes[s];
+		size_t size = (size_t)n * n;
+		dtype_t* A = cpu_alloc(size * sizeof(dtype_t));
+		dtype_t* B = cpu_alloc(size * sizeof(dtype_t));
+		dtype_t* C = cpu_alloc(size * sizeof(dtype_t));
+		dtype_t* C_f32 = cpu_alloc(size * sizeof(dtype_t));
+		uint8_t* A_u8 = cpu_alloc(size);
+		int8_t* B_s8 = cpu_alloc(size);
+		int8_t* C_s8 = cpu_alloc(size);
+		float* scale = malloc(n * sizeof(float));
+		if(!A || !B || !C || !C_f32 || !A_u8 || !B_s8 || !C_s8 || !scale) {
+			error("out of memory\n");
+			failed = 1;
+		}
+		for(size_t i = 0; !failed && i < size; i++) {
+			A[i] = 2.0f * rand() / RAND_MAX - 1;
+			B[i] = 2.0f * rand() / RAND_MAX - 1;
+		}
+		// A in [-1, 1] as u8 around 128, each column of B (column major) over its range
+		GemmQuantization q = { .zero_a = 128, .scale = scale, .per_channel = 1 };
+		float scale_a = 2.0f / 255;
+		if(!failed) {
+			cpu_quantize_u8(A_u8, A, size, scale_a, q.zero_a);
+		}
+		for(uint32_t j = 0; !failed && j < n; j++) {
+			float range = 0;
+			for(uint32_t k = 0; k < n; k++) range = fmaxf(range, fabsf(B[(size_t)j * n + k]));
+			cpu_quantize_s8(&B_s8[(size_t)j * n], &B[(size_t)j * n], n, range / 127, 0);
+			scale[j] = scale_a * range / 127;
+		}
+		if(failed) {
+			goto next;
+		}
+		printf("%u x %u x %u:\n", n, n, n);
+		memset(C, 0x00, size * sizeof(dtype_t));
+		double start = omp_get_wtime();
+		gemm_rrc(ctx, C, A, B, n, n, n);
+		double time = omp_get_wtime() - start;
+		printf("\t[FP32 (gemm_rrc)]: %.2es\n", time);
+
+		start = omp_get_wtime();
+		gemm_rrc_u8s8_f32(ctx, n, n, n, A_u8, n, B_s8, n, &q, C_f32, n);
+		time = omp_get_wtime() - start;
+		printf("\t[U8 x S8 -> FP32]: %.2es, max relative error %.2e\n", time, max_relative_error(C_f32, C, n, n));
+
+		// C back in int8 over its own range
+		float range = 0;
+		for(size_t i = 0; i < size; i++) range = fmaxf(range, fabsf(C[i]));
+		q.scale_c = range / 127;
+		start = omp_get_wtime();
+		gemm_rrc_u8s8_s8(ctx, n, n, n, A_u8, n, B_s8, n, &q, C_s8, n);
+		time = omp_get_wtime() - start;
+		for(size_t i = 0; i < size; i++) C_f32[i] = q.scale_c * C_s8[i];
+		printf("\t[U8 x S8 -> S8]: %.2es, max relative error %.2e\n", time, max_relative_error(C_f32, C, n, n));
+next:
+		cpu_free(A);
+		cpu_free(B);
+		cpu_free(C);
+		cpu_free(C_f32);
+		cpu_free(A_u8);
+		cpu_free(B_s8);
+		cpu_free(C_s8);
+		free(scale);
+	}
+	cpu_context_destroy(ctx);
+	return failed;
+}
+
 int createPlotRow(EvaluationSuite suite, FILE* file) {
 
 	double time = 0.0F;
@@ -197,7 +666,130 @@ int createPlotRow(EvaluationSuite suite, FILE* file) {
 	}
 	fprintf(file, "%.2es,", time);
 
+	suite.f = gemm_rrc_blis_avx;
+	suite.name = "BLIS (6x16 MICRO-KERNEL & AVX)";
+	if(evaluate(&suite, &time)) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
+	// run with `sde64 -spr -- ./build/main/gemm` to check them on hosts without AVX-512
+	if(cpu_isa() >= CPU_ISA_AVX512) {
+		suite.f = gemm_rrc_blocked_avx512;
+		suite.name = "BLOCKED & PACKING & AVX512 (RRC with reduction)";
+		if(evaluate(&suite, &time)) {
+			goto defer;
+		}
+		fprintf(file, "%.2es,", time);
+
+		suite.f = gemm_rrc_blis_avx512;
+		suite.name = "BLIS (14x32 MICRO-KERNEL & AVX512)";
+		if(evaluate(&suite, &time)) {
+			goto defer;
+		}
+		fprintf(file, "%.2es,", time);
+	} else {
+		fprintf(file, "nan,nan,");
+	}
+
+	suite.f = gemm_rrc_blis_jit;
+	suite.name = "BLIS (JIT MICRO-KERNEL)";
+	if(evaluate(&suite, &time)) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
+	PrepackedB prepacked = {
+		.ctx = suite.userdata,
+		.packed = gemm_pack_b(suite.userdata, suite.B, suite.nk, suite.nj, GEMM_COL_MAJOR),
+	};
+	suite.f = gemm_rrc_prepacked;
+	suite.userdata = &prepacked;
+	suite.name = "BLIS (PRE-PACKED B)";
+	int failed = !prepacked.packed || evaluate(&suite, &time);
+	suite.userdata = prepacked.ctx;
+	gemm_packed_b_free(prepacked.packed);
+	if(failed) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
+	TiledOperands tiled = {
+		.ctx = suite.userdata,
+		.A = cpu_tiled_from(suite.A, suite.ni, suite.nk, GEMM_ROW_MAJOR, 0),
+		.B = cpu_tiled_from(suite.B, suite.nk, suite.nj, GEMM_COL_MAJOR, 0),
+	};
+	suite.f = gemm_rtt_tiled_operands;
+	suite.userdata = &tiled;
+	suite.name = "TILED (BLOCK-MAJOR) & NO PACKING";
+	failed = !tiled.A || !tiled.B || evaluate(&suite, &time);
+	suite.userdata = tiled.ctx;
+	cpu_tiled_free(tiled.A);
+	cpu_tiled_free(tiled.B);
+	if(failed) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
+	suite.f = gemm_rrc_recursive;
+	suite.name = "RECURSIVE (CACHE-OBLIVIOUS)";
+	if(evaluate(&suite, &time)) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
+	// the default entry point: unrolled kernels for the small sizes, BLIS for
+	// the rest. Also the classical result Strassen is compared against
+	double classical_time;
+	suite.f = gemm_rrc;
+	suite.name = "DEFAULT (UNROLLED SMALL SIZES / BLIS)";
+	failed = evaluate(&suite, &classical_time);
+	dtype_t* classical = failed ? NULL : cpu_alloc(suite.ni * suite.nj * sizeof(dtype_t));
+	if(!classical) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", classical_time);
+	memcpy(classical, suite.C, suite.ni * suite.nj * sizeof(dtype_t));
+	suite.f = gemm_rrc_strassen;
+	suite.name = "STRASSEN-WINOGRAD";
+	if(!(failed = evaluate(&suite, &time))) {
+		printf("\t[STRASSEN-WINOGRAD] max relative error vs classical %.2e, speedup %.2fx\n", max_relative_error(suite.C, classical, suite.ni, suite.nj), classical_time / time);
+	}
+	cpu_free(classical);
+	if(failed) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
+	// fp32 through gemm_blas, then the type-generic family
+	suite.f = gemm_rrc_blas_f32;
+	suite.name = "BLAS (FP32)";
+	if(evaluate(&suite, &time)) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
+	suite.name = "GENERIC BLIS (FP64)";
+	if(evaluate_f64(&suite, &time)) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
+	// and with 16-bit inputs, against the fp32 column above
+	suite.name = "GENERIC BLIS (BF16 INPUTS)";
+	if(evaluate_16bit(&suite, 0, &time)) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
+	suite.name = "GENERIC BLIS (FP16 INPUTS)";
+	if(evaluate_16bit(&suite, 1, &time)) {
+		goto defer;
+	}
+	fprintf(file, "%.2es,", time);
+
 	suite.f = (void (*)(void *, dtype_t *, dtype_t *, dtype_t *, uint32_t, uint32_t, uint32_t))gemm_gpu;
+	suite.userdata = &suite.gpu;
 	suite.name = "GPU (WGPU) + Copies";
 	if(evaluate(&suite, &time)) {
 		goto defer;
@@ -214,11 +806,13 @@ defer:
 int createPlot(char* output_path) {
 	FILE* f = NULL;
 	EvaluationSuite suite = {0};
+	// one context for every size, like a long running caller would keep
+	GemmContext* ctx = cpu_context_create(0);
 	if((f = fopen(output_path, "w")) == NULL) {
 		error("Error when opening file\n");
 		goto defer;
 	}
-	fprintf(f, "N,BLOCKED,BLOCKED & PACKING,BLOCKED & PACKING & AVX (CCR),BLOCKED & PACKING & AVX (RRC to RRR packing),BLOCKED & PACKING & AVX (RRC with reduction),BLOCKED & PACKING & AVX (RRC with reduction) & OMP,GPU,GPU+Copies\n");
+	fprintf(f, "N,BLOCKED,BLOCKED & PACKING,BLOCKED & PACKING & AVX (CCR),BLOCKED & PACKING & AVX (RRC to RRR packing),BLOCKED & PACKING & AVX (RRC with reduction),BLOCKED & PACKING & AVX (RRC with reduction) & OMP,BLIS (6x16 MICRO-KERNEL & AVX),BLOCKED & PACKING & AVX512 (RRC with reduction),BLIS (14x32 MICRO-KERNEL & AVX512),BLIS (JIT MICRO-KERNEL),BLIS (PRE-PACKED B),TILED (BLOCK-MAJOR) & NO PACKING,RECURSIVE (CACHE-OBLIVIOUS),DEFAULT (UNROLLED SMALL SIZES / BLIS),STRASSEN-WINOGRAD,BLAS (FP32),GENERIC BLIS (FP64),GENERIC BLIS (BF16 INPUTS),GENERIC BLIS (FP16 INPUTS),GPU,GPU+Copies\n");
 	#ifdef DEBUG
 	int check = 1;
 	#else
@@ -226,6 +820,7 @@ int createPlot(char* output_path) {
 	#endif
 	for(uint32_t n = 1; n <= 4096; n += (n + 100) % 100) {
 		suite = createSuite(n, n, n, check);
+		suite.userdata = ctx;
 		fprintf(f, "%u,", n);
 		if(createPlotRow(suite, f)) {
 			error("Error when creating row\n");
@@ -235,15 +830,59 @@ int createPlot(char* output_path) {
 		fflush(f);
 	}
 	fclose(f);
+	JitStats jit = cpu_jit_stats();
+	printf("jit: %u micro-kernels, %zu bytes of code\n", jit.kernels, jit.bytes);
+	cpu_context_destroy(ctx);
 
 	return 0;
 defer:
 	freeSuite(suite);
+	cpu_context_destroy(ctx);
 	return 1;
 }
 
-int main(void) {
+int main(int argc, char** argv) {
 	srand(0);
+	printf("CPU kernels bound to %s\n", cpu_isa_name(cpu_isa()));
+	const CacheInfo* cache = cpu_cache_info();
+	printf("L1d %u KiB (%u-way), L2 %u KiB (%u-way), L3 %u KiB (%u-way)\n",
+		cache->l1d.size / 1024, cache->l1d.ways,
+		cache->l2.size / 1024, cache->l2.ways,
+		cache->l3.size / 1024, cache->l3.ways);
+	printf("large matrices on %s\n", cpu_huge_pages_name(cpu_huge_pages()));
+
+	// gemm --tune [file] searches the block sizes for this machine and saves
+	// them to file (default: cpu_tuning_path()), which later runs load
+	if(argc > 1 && !strcmp(argv[1], "--tune")) {
+		const char* path = argc > 2 ? argv[2] : cpu_tuning_path();
+		return cpu_tune(path, stdout);
+	}
+	// gemm --gemv reports the matrix-vector path instead of the plot
+	if(argc > 1 && !strcmp(argv[1], "--gemv")) {
+		return createGemvReport();
+	}
+	// gemm --shapes compares the threaded kernels across aspect ratios
+	if(argc > 1 && !strcmp(argv[1], "--shapes")) {
+		return createShapesReport();
+	}
+	// gemm --layouts runs every layout combination without copies
+	if(argc > 1 && !strcmp(argv[1], "--layouts")) {
+		return createLayoutsReport();
+	}
+	// gemm --accuracy compares plain and compensated accumulation for deep nk
+	if(argc > 1 && !strcmp(argv[1], "--accuracy")) {
+		return createAccuracyReport();
+	}
+	// gemm --int8 compares the quantized kernels with fp32
+	if(argc > 1 && !strcmp(argv[1], "--int8")) {
+		return createInt8Report();
+	}
+	const char* tuning_path = cpu_tuning_path();
+	if(cpu_tuning()->loaded) {
+		printf("block sizes tuned in %s\n", tuning_path);
+	} else {
+		printf("analytical block sizes (run `gemm --tune` to tune them)\n");
+	}
 
 	return createPlot("plot.csv");
 }
@@ -0,0 +1,33 @@
+#ifndef CPU_ALLOC_H
+#define CPU_ALLOC_H
+
+#include <stddef.h>
+
+// alignment of everything cpu_alloc returns, one cache line (a zmm register)
+#define GEMM_ALIGNMENT 64
+
+// allocations from this size on are mmap'd so they can use huge pages
+#define GEMM_HUGE_PAGE_SIZE (2u * 1024 * 1024)
+
+typedef enum {
+	HUGE_PAGES_NONE,
+	HUGE_PAGES_TRANSPARENT, // madvise(MADV_HUGEPAGE)
+	HUGE_PAGES_EXPLICIT, // MAP_HUGETLB, needs pages reserved in /proc/sys/vm/nr_hugepages
+} HugePages;
+
+// GEMM_ALIGNMENT aligned memory for matrices and packing buffers. Allocations
+// of at least GEMM_HUGE_PAGE_SIZE are backed by explicit huge pages while there
+// are free ones, transparent huge pages otherwise and plain pages when neither
+// is available (or GEMM_HUGE_PAGES=0 is set)
+void* cpu_alloc(size_t size);
+// zeroed, like calloc, and NULL when n * size overflows
+void* cpu_calloc(size_t n, size_t size);
+void cpu_free(void* p);
+
+// pages behind an allocation of cpu_alloc
+HugePages cpu_alloc_pages(const void* p);
+// best pages large allocations can get on this host
+HugePages cpu_huge_pages(void);
+const char* cpu_huge_pages_name(HugePages pages);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CPU_CACHE_H
+#define CPU_CACHE_H
+
+#include <stdint.h>
+
+typedef struct {
+	uint32_t size; // in bytes
+	uint32_t ways;
+	uint32_t line_size;
+	uint32_t sets;
+} CacheLevel;
+
+typedef struct {
+	CacheLevel l1d;
+	CacheLevel l2;
+	CacheLevel l3;
+} CacheInfo;
+
+typedef struct {
+	uint32_t mc;
+	uint32_t kc;
+	uint32_t nc;
+} BlisBlocking;
+
+// data cache hierarchy of cpu0, read from /sys/devices/system/cpu/cpu0/cache,
+// then cpuid (leaf 4 or 0x8000001D) and conservative defaults as fallbacks.
+// It is probed on the first call, which the kernels do from load-time
+// constructors, so it is read only afterwards
+const CacheInfo* cpu_cache_info(void);
+
+// MC/KC/NC for a mr x nr micro-kernel, following the analytical model from
+// "Analytical Modeling Is Enough for High-Performance BLIS" (Low et al.):
+// the KC x nr micro-panel of B stays in L1 next to a streamed mr x KC
+// micro-panel of A, the MC x KC block of A fills L2 and the KC x NC block of B
+// fills L3, each leaving one way free for the streamed data
+BlisBlocking cpu_blis_blocking(uint32_t mr, uint32_t nr, uint32_t element_size);
+
+// block size (multiple of 16) of the square blocked kernels: the packed A and
+// B blocks plus the block of C they update take a quarter of L2
+uint32_t cpu_square_blocking(uint32_t element_size);
+
+#endif
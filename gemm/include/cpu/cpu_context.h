@@ -0,0 +1,109 @@
+#ifndef CPU_CONTEXT_H
+#define CPU_CONTEXT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <omp.h>
+#include "common.h"
+#include "cpu/cpu_tune.h"
+#include "cpu/cpu_alloc.h"
+#include "cpu/cpu_pack_cache.h"
+
+// packing buffers of one thread, capacities in elements
+typedef struct {
+	dtype_t* block_a;
+	size_t size_a;
+	dtype_t* block_b;
+	size_t size_b;
+} GemmWorkspace;
+
+// state kept between calls, passed to the CPU kernels through their userdata
+// parameter. The workspaces come from cpu_alloc and only grow, so once they fit
+// the largest call the kernels allocate nothing. With userdata == NULL the
+// kernels allocate their buffers on every call and use cpu_tuning(). A context
+// is not thread safe: the single threaded paths all pack into workspaces[0] and
+// the pack cache has no lock, so concurrent callers need one context each
+typedef struct {
+	const GemmTuning* tuning; // cpu_tuning() unless pointed somewhere else
+	uint32_t n_threads; // team size of the OpenMP kernels, whose pool OpenMP keeps alive between calls
+	GemmWorkspace* workspaces; // one per thread of the team
+	PackCache pack_cache; // packed operands of the BLIS kernels, off unless given a budget
+	uint64_t epoch; // part of the cache keys, bump it after writing to an operand in place
+	int reproducible; // see cpu_context_set_reproducible
+} GemmContext;
+
+// n_threads == 0 uses omp_get_max_threads(). The pack cache starts disabled
+GemmContext* cpu_context_create(uint32_t n_threads);
+void cpu_context_destroy(GemmContext* ctx);
+
+// bytes of packed panels the context may keep, 0 disables the cache. With the
+// cache on, the BLIS kernels (gemm_rrc, gemm_rrc_blis_*) look their packed A
+// and B up by pointer, shape, layout and epoch before packing them, so callers
+// must bump epoch (or clear the cache) when they modify an operand in place
+void cpu_context_set_pack_cache(GemmContext* ctx, size_t budget);
+PackCacheStats cpu_context_pack_cache_stats(const GemmContext* ctx);
+
+// with reproducible set, gemm_rrc and gemm_rrc_blis_omp give the same bits for
+// the same operands whatever the thread count of the context and the ISA bound
+// at load time: fixed KC blocking, fixed split-K slices and reduction tree and
+// one fused multiply-add per term (see README). Contexts start with
+// cpu_reproducible(), which is also the mode of calls without a context
+void cpu_context_set_reproducible(GemmContext* ctx, int reproducible);
+// nonzero when $GEMM_REPRODUCIBLE is set to anything but 0
+int cpu_reproducible(void);
+
+// buffers of the given thread with room for size_a and size_b elements, NULL
+// when they couldn't be allocated (the kernels then compute without packing).
+// Without a context they are allocated into *scratch, which
+// cpu_workspace_release frees
+GemmWorkspace* cpu_workspace_acquire(GemmContext* ctx, uint32_t thread, size_t size_a, size_t size_b, GemmWorkspace* scratch);
+void cpu_workspace_release(GemmWorkspace* ws, GemmWorkspace* scratch);
+
+// products of fewer multiply-adds run on the calling thread
+#define GEMM_PARALLEL_MIN (1u << 18)
+
+// team size for an (ni, nj, nk) product: the threads of the context (OpenMP's
+// default without one), or 1 below GEMM_PARALLEL_MIN
+static inline uint32_t cpu_gemm_threads(const GemmContext* ctx, uint32_t ni, uint32_t nj, uint32_t nk) {
+	if((uint64_t)ni * nj * nk < GEMM_PARALLEL_MIN) {
+		return 1;
+	}
+	return ctx ? ctx->n_threads : (uint32_t)omp_get_max_threads();
+}
+
+// C cut into one strip per thread along its rows (by_rows) or columns, every
+// strip but the last a whole number of register tiles wide. count is the team
+// size to fork, at least 1 even for an empty side
+typedef struct {
+	int by_rows;
+	uint32_t side; // rows or columns of C
+	uint32_t width; // of every strip but the last
+	uint32_t count;
+} GemmStrips;
+
+static inline GemmStrips cpu_strips_along(int by_rows, uint32_t side, uint32_t tile, uint32_t n_threads) {
+	GemmStrips strips = { by_rows, side, 0, 1 };
+	if(side) {
+		strips.width = (side + n_threads - 1) / n_threads;
+		strips.width = (strips.width + tile - 1) / tile * tile;
+		strips.count = (side + strips.width - 1) / strips.width;
+	}
+	return strips;
+}
+
+// along the longer side of an (ni, nj) C of mr x nr tiles, so tall and skinny
+// or short and wide shapes split as evenly as square ones
+static inline GemmStrips cpu_strips(uint32_t ni, uint32_t nj, uint32_t mr, uint32_t nr, uint32_t n_threads) {
+	int by_rows = ni >= nj;
+	return cpu_strips_along(by_rows, by_rows ? ni : nj, by_rows ? mr : nr, n_threads);
+}
+
+// first row or column of strip s, and its length through size (0 past the end)
+static inline uint32_t cpu_strip(const GemmStrips* strips, uint32_t s, uint32_t* size) {
+	uint32_t begin = s * strips->width;
+	*size = begin < strips->side ? strips->side - begin : 0;
+	*size = *size < strips->width ? *size : strips->width;
+	return begin;
+}
+
+#endif
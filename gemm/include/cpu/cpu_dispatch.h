@@ -0,0 +1,94 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+// every kernel with the common GEMM signature. src/cpu/cpu_gemm.c is compiled
+// once per instruction set with GEMM_ISA set (see the Makefile), which
+// suffixes these symbols (gemm_rrc -> gemm_rrc_isa_avx2), and
+// src/cpu/cpu_dispatch.c defines the unsuffixed ones on top of the best build
+// the host supports
+#define CPU_GEMM_KERNELS(X) \
+	X(gemm_rrc_naive) \
+	X(gemm_rrc_blocked_without_packing) \
+	X(gemm_rrc_blocked) \
+	X(gemm_ccr_blocked_avx) \
+	X(gemm_rrc_to_rrr_blocked_avx) \
+	X(gemm_rrc_blocked_avx) \
+	X(gemm_rrc_blocked_avx_and_omp) \
+	X(gemm_rrc_blis_avx) \
+	X(gemm_rrc_blocked_avx512) \
+	X(gemm_rrc_blis_avx512) \
+	X(gemm_rrc_blis_jit) \
+	X(gemm_rrc_blis_omp) \
+	X(gemm_rrc_blis_compensated) \
+	X(gemm_rrc_recursive) \
+	X(gemm_rrc_strassen) \
+	X(gemm_rrc)
+
+// the ones with other signatures, bound along with them
+#define CPU_GEMM_OTHER_FUNCTIONS(X) \
+	X(gemm_blas) \
+	X(gemm_pack_b) \
+	X(gemm_compute) \
+	X(gemm_ttt_tiled) \
+	X(gemm_rtt_tiled) \
+	X(gemv_r) \
+	X(gemv_c) \
+	X(gemm_blas_f64) \
+	X(gemm_blas_bf16) \
+	X(gemm_blas_f16) \
+	X(gemm_rrc_u8s8_f32) \
+	X(gemm_rrc_u8s8_s8)
+
+typedef enum {
+	CPU_ISA_SCALAR,
+	CPU_ISA_SSE2,
+	CPU_ISA_AVX2,
+	CPU_ISA_AVX512,
+} CpuIsa;
+
+// best ISA the host supports according to cpuid (and xgetbv for the OS support
+// of the ymm/zmm state)
+CpuIsa cpu_isa_detect(void);
+
+// ISA the kernels were bound to at load time. The GEMM_ISA environment variable
+// (scalar, sse2, avx2 or avx512) can lower it, e.g. to compare builds
+CpuIsa cpu_isa(void);
+
+const char* cpu_isa_name(CpuIsa isa);
+
+#endif
+
+#ifdef GEMM_ISA
+#define CPU_ISA_CONCAT_(name, isa) name##_isa_##isa
+#define CPU_ISA_CONCAT(name, isa) CPU_ISA_CONCAT_(name, isa)
+#define CPU_ISA_SYMBOL(name) CPU_ISA_CONCAT(name, GEMM_ISA)
+
+#define gemm_rrc_naive CPU_ISA_SYMBOL(gemm_rrc_naive)
+#define gemm_rrc_blocked_without_packing CPU_ISA_SYMBOL(gemm_rrc_blocked_without_packing)
+#define gemm_rrc_blocked CPU_ISA_SYMBOL(gemm_rrc_blocked)
+#define gemm_ccr_blocked_avx CPU_ISA_SYMBOL(gemm_ccr_blocked_avx)
+#define gemm_rrc_to_rrr_blocked_avx CPU_ISA_SYMBOL(gemm_rrc_to_rrr_blocked_avx)
+#define gemm_rrc_blocked_avx CPU_ISA_SYMBOL(gemm_rrc_blocked_avx)
+#define gemm_rrc_blocked_avx_and_omp CPU_ISA_SYMBOL(gemm_rrc_blocked_avx_and_omp)
+#define gemm_rrc_blis_avx CPU_ISA_SYMBOL(gemm_rrc_blis_avx)
+#define gemm_rrc_blocked_avx512 CPU_ISA_SYMBOL(gemm_rrc_blocked_avx512)
+#define gemm_rrc_blis_avx512 CPU_ISA_SYMBOL(gemm_rrc_blis_avx512)
+#define gemm_rrc_blis_jit CPU_ISA_SYMBOL(gemm_rrc_blis_jit)
+#define gemm_rrc_blis_omp CPU_ISA_SYMBOL(gemm_rrc_blis_omp)
+#define gemm_rrc_blis_compensated CPU_ISA_SYMBOL(gemm_rrc_blis_compensated)
+#define gemm_rrc_recursive CPU_ISA_SYMBOL(gemm_rrc_recursive)
+#define gemm_rrc_strassen CPU_ISA_SYMBOL(gemm_rrc_strassen)
+#define gemm_rrc CPU_ISA_SYMBOL(gemm_rrc)
+#define gemm_blas CPU_ISA_SYMBOL(gemm_blas)
+#define gemm_pack_b CPU_ISA_SYMBOL(gemm_pack_b)
+#define gemm_compute CPU_ISA_SYMBOL(gemm_compute)
+#define gemm_ttt_tiled CPU_ISA_SYMBOL(gemm_ttt_tiled)
+#define gemm_rtt_tiled CPU_ISA_SYMBOL(gemm_rtt_tiled)
+#define gemv_r CPU_ISA_SYMBOL(gemv_r)
+#define gemv_c CPU_ISA_SYMBOL(gemv_c)
+#define gemm_blas_f64 CPU_ISA_SYMBOL(gemm_blas_f64)
+#define gemm_blas_bf16 CPU_ISA_SYMBOL(gemm_blas_bf16)
+#define gemm_blas_f16 CPU_ISA_SYMBOL(gemm_blas_f16)
+#define gemm_rrc_u8s8_f32 CPU_ISA_SYMBOL(gemm_rrc_u8s8_f32)
+#define gemm_rrc_u8s8_s8 CPU_ISA_SYMBOL(gemm_rrc_u8s8_s8)
+#endif
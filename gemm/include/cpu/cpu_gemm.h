@@ -3,6 +3,16 @@
 
 #include <stdint.h>
 #include "common.h"
+#include "cpu/cpu_dispatch.h"
+#include "cpu/cpu_packed.h"
+#include "cpu/cpu_tiled.h"
+#include "cpu/cpu_half.h"
+#include "cpu/cpu_quant.h"
+
+// C += A B for (ni, nj) C, (ni, nk) A and (nk, nj) B, the layouts are in the
+// name (gemm_<C><A><B>_..., r for row major and c for column major). userdata
+// is a GemmContext (cpu/cpu_context.h) to reuse buffers between calls, or NULL
+typedef void (*GemmKernel)(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
 
 void gemm_rrc_naive(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
 void gemm_rrc_blocked_without_packing(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
@@ -11,5 +21,92 @@ void gemm_ccr_blocked_avx(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, ui
 void gemm_rrc_to_rrr_blocked_avx(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
 void gemm_rrc_blocked_avx(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
 void gemm_rrc_blocked_avx_and_omp(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+void gemm_rrc_blis_avx(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+
+// AVX-512F variants, on hosts without AVX-512 they run the widest kernels available
+void gemm_rrc_blocked_avx512(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+void gemm_rrc_blis_avx512(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+
+// BLIS with micro-kernels generated at run time for the KC of each block (see
+// cpu/cpu_jit.h), the widest ISA of the build. Plain BLIS without AVX2
+void gemm_rrc_blis_jit(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+
+// multithreaded BLIS that follows the shape: C is split between the threads
+// along its longer side, A is packed once per KC panel when it is short and
+// wide, rank-k updates (small nk) stream C once without packing and nk much
+// larger than C is split between the threads instead (split-K)
+void gemm_rrc_blis_omp(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+
+// gemm_rrc_blis_omp with compensated (Neumaier) accumulation across the KC
+// panels and split-K partials, for very deep nk: the error stays around one
+// rounding of a KC long dot product instead of growing with nk
+void gemm_rrc_blis_compensated(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+
+// cache-oblivious: halves the largest dimension until the problem fits L1, no
+// block sizes to tune
+void gemm_rrc_recursive(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+
+// Strassen-Winograd down to the strassen_cutoff of the tuning, BLIS below it.
+// Fewer multiplications for a larger (though still normwise bounded) error
+void gemm_rrc_strassen(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+
+// default fp32 path: C += A B with C row major, A row major and B column major
+void gemm_rrc(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+
+// C = alpha op(A) op(B) + beta C like the BLAS sgemm, for (ni, nj) C, (ni, nk)
+// op(A) and (nk, nj) op(B), all in the given layout. op(X) is X or X^T
+// (trans_a, trans_b), and lda, ldb and ldc are the strides between the rows
+// (row major) or columns (column major) of A, B and C as stored, so views of
+// submatrices run without copies. Packing absorbs the layouts and alpha. beta 0
+// overwrites C without reading it
+void gemm_blas(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, dtype_t alpha, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, dtype_t beta, dtype_t* C, uint32_t ldc);
+
+// B packed once for many products with it (e.g. weights), in the layout and
+// blocking the BLIS kernel of gemm_rrc uses. Free it with gemm_packed_b_free.
+// NULL when out of memory
+GemmPackedB* gemm_pack_b(void* userdata, dtype_t* B, uint32_t nk, uint32_t nj, GemmLayout layout);
+// C += A B with C (ni, B->nj) and A (ni, B->nk) row major, without packing B.
+// Large products share the rows of A out between the threads of the context
+void gemm_compute(void* userdata, dtype_t* C, dtype_t* A, const GemmPackedB* B, uint32_t ni);
+
+// C += A B on tiled matrices (t in the name, see cpu/cpu_tiled.h), whose tiles
+// are multiplied in place without packing. A and B must have the same tile
+// and A->cols == B->rows. C is tiled too (same tile, A->rows x B->cols), or
+// (A->rows, B->cols) row major
+void gemm_ttt_tiled(void* userdata, TiledMatrix* C, const TiledMatrix* A, const TiledMatrix* B);
+void gemm_rtt_tiled(void* userdata, dtype_t* C, const TiledMatrix* A, const TiledMatrix* B);
+
+// y += A x with y (ni), x (nk) and A (ni, nk) row major (gemv_r) or column
+// major (gemv_c). Memory bound: A is streamed once, split by rows between the
+// threads of the context when it is large. gemm_rrc sends nj == 1 and ni == 1
+// here
+void gemv_r(void* userdata, dtype_t* y, dtype_t* A, dtype_t* x, uint32_t ni, uint32_t nk);
+void gemv_c(void* userdata, dtype_t* y, dtype_t* A, dtype_t* x, uint32_t ni, uint32_t nk);
+
+// gemm_blas for float and double, both from the BLIS driver of
+// src/cpu/cpu_gemm_typed.h. gemm_blas_f32 is gemm_blas itself (dtype_t is
+// float), with the hand-tuned micro-kernels. gemm_blas_f64 runs the generic one
+// with register tiles per ISA: 6x8 for 4-wide AVX2 vectors, 14x16 for 8-wide
+// AVX-512 ones. Its block sizes are the analytical ones (gemm --tune doesn't
+// search them), and it has no GEMV, small-size, split-K or reproducible paths
+void gemm_blas_f32(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, float alpha, float* A, uint32_t lda, float* B, uint32_t ldb, float beta, float* C, uint32_t ldc);
+void gemm_blas_f64(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, double alpha, double* A, uint32_t lda, double* B, uint32_t ldb, double beta, double* C, uint32_t ldc);
+
+// the same with 16-bit A and B (see cpu/cpu_half.h) widened to fp32 while they
+// are packed, so they are read from memory at half the size: fp32 arithmetic,
+// accumulation and C. bf16 is widened with a shift, fp16 with F16C when the
+// build has it
+void gemm_blas_bf16(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, float alpha, bf16_t* A, uint32_t lda, bf16_t* B, uint32_t ldb, float beta, float* C, uint32_t ldc);
+void gemm_blas_f16(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, float alpha, f16_t* A, uint32_t lda, f16_t* B, uint32_t ldb, float beta, float* C, uint32_t ldc);
+
+// quantized C = A B (see cpu/cpu_quant.h) for u8 A (ni, nk) in rows of lda and
+// s8 B (nk, nj) in columns of ldb, e.g. activations times the weights of one
+// output channel per column. The products are summed exactly in int32 (nk up
+// to 65536) and the epilogue subtracts the zero points through the row sums of
+// A and column sums of B, scales, adds the bias and stores C (rows of ldc) in
+// fp32 or requantized to s8. AVX512-VNNI when the host has it, 16-bit
+// multiply-adds otherwise
+void gemm_rrc_u8s8_f32(void* userdata, uint32_t ni, uint32_t nj, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, float* C, uint32_t ldc);
+void gemm_rrc_u8s8_s8(void* userdata, uint32_t ni, uint32_t nj, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, int8_t* C, uint32_t ldc);
 
 #endif
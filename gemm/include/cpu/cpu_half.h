@@ -0,0 +1,43 @@
+#ifndef CPU_HALF_H
+#define CPU_HALF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// 16-bit storage formats, as raw bits
+typedef uint16_t bf16_t; // bfloat16: the upper half of a float
+typedef uint16_t f16_t; // IEEE 754 binary16
+
+// exact widening to fp32
+static inline float cpu_bf16_to_f32(bf16_t x) {
+	uint32_t u = (uint32_t)x << 16;
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+static inline float cpu_f16_to_f32(f16_t x) {
+	uint32_t sign = (uint32_t)(x & 0x8000) << 16, exponent = (x >> 10) & 0x1f, mantissa = x & 0x3ff;
+	if(!exponent) {
+		// zero or subnormal, mantissa * 2^-24
+		float f = (float)mantissa * 0x1p-24f;
+		return sign ? -f : f;
+	}
+	// infinities and NaNs keep the all ones exponent, normal numbers are rebiased
+	uint32_t u = sign | (exponent == 0x1f ? 0x7f800000 : (exponent + 112) << 23) | mantissa << 13;
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+// rounded to nearest even, NaNs stay NaNs and fp16 overflows to infinity
+bf16_t cpu_f32_to_bf16(float x);
+f16_t cpu_f32_to_f16(float x);
+
+// n values at a time, e.g. for the operands of gemm_blas_bf16 or to store the
+// fp32 C it computes in 16 bits
+void cpu_bf16_from_f32(bf16_t* dst, const float* src, size_t n);
+void cpu_f16_from_f32(f16_t* dst, const float* src, size_t n);
+
+#endif
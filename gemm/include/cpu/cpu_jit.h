@@ -0,0 +1,56 @@
+#ifndef CPU_JIT_H
+#define CPU_JIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "cpu/cpu_packed.h"
+
+typedef enum {
+	JIT_AVX2, // ymm0-15, VEX encoded FMA3
+	JIT_AVX512, // zmm0-31, EVEX encoded AVX-512F
+} JitIsa;
+
+typedef enum {
+	JIT_ACCUMULATE, // C += A B
+	JIT_STORE, // C = A B
+} JitEpilogue;
+
+// same signature as the micro-kernels of cpu_gemm.c: C (m, n) from the k x mr
+// micro-panel a and the k x nr micro-panel b, with ldc the stride of C
+typedef void (*JitKernel)(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n);
+
+// what a kernel is generated for. With layout GEMM_ROW_MAJOR the vectors run
+// along the nr columns of a row of C (nr a multiple of the vector width) and
+// ldc separates rows, with GEMM_COL_MAJOR along the mr rows of a column
+typedef struct {
+	JitIsa isa;
+	uint32_t mr;
+	uint32_t nr;
+	uint32_t k;
+	GemmLayout layout;
+	JitEpilogue epilogue;
+	JitKernel fallback; // tail-called for any other k, m or n
+} JitSpec;
+
+typedef struct {
+	uint32_t kernels;
+	size_t bytes; // of machine code
+	uint64_t hits;
+	uint64_t misses;
+} JitStats;
+
+// a kernel with k, mr and nr baked in as constants: no runtime trip counts and
+// no edge handling, the accumulators stay in registers for the whole k loop.
+// Calls with other k, m or n jump to spec->fallback, so it can stand in for the
+// kernel it falls back to. Generated on the first request and cached for the
+// life of the process (thread safe). NULL when the tile doesn't fit the
+// registers of the ISA, there is no fallback, mapping executable memory fails
+// or GEMM_JIT=0 is set
+JitKernel cpu_jit_kernel(const JitSpec* spec);
+
+JitStats cpu_jit_stats(void);
+// unmaps every generated kernel, none of them may be running or called again
+void cpu_jit_clear(void);
+
+#endif
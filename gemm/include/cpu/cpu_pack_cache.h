@@ -0,0 +1,68 @@
+#ifndef CPU_PACK_CACHE_H
+#define CPU_PACK_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "cpu/cpu_packed.h"
+
+// identity of a packed operand: the source buffer as the caller passed it, the
+// epoch of the context at the time (bumped by the caller when it writes to its
+// operands in place) and the blocking it was packed with. A (ni, nk) row major
+// A is packed as the (nk, ni) column major B of A^T, with MC and MR
+typedef struct {
+	const dtype_t* src;
+	uint32_t nk;
+	uint32_t n;
+	GemmLayout layout;
+	uint64_t epoch;
+	uint32_t kc;
+	uint32_t nc;
+	uint32_t nr;
+} PackKey;
+
+typedef struct {
+	PackKey key;
+	GemmPackedB* packed;
+	size_t bytes;
+	uint64_t last_use; // PackCache.clock of the last call that used it
+} PackCacheEntry;
+
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	size_t bytes; // packed panels held right now
+	uint32_t entries;
+} PackCacheStats;
+
+// least recently used packed operands of a GemmContext, at most budget bytes of
+// panels. Entries used by the current call (last_use == clock) are never
+// evicted, an operand that doesn't fit next to them isn't packed whole at all
+typedef struct {
+	size_t budget; // 0 disables the cache
+	uint64_t clock; // one tick per call
+	PackCacheEntry* entries;
+	uint32_t n_entries;
+	uint32_t capacity;
+	PackCacheStats stats;
+} PackCache;
+
+void cpu_pack_cache_init(PackCache* cache, size_t budget);
+void cpu_pack_cache_free(PackCache* cache);
+// evicts least recently used entries down to the new budget
+void cpu_pack_cache_set_budget(PackCache* cache, size_t budget);
+void cpu_pack_cache_clear(PackCache* cache);
+
+// starts a call: the entries found or inserted until the next one are pinned
+void cpu_pack_cache_begin(PackCache* cache);
+// NULL on a miss, both count in the stats
+GemmPackedB* cpu_pack_cache_find(PackCache* cache, const PackKey* key);
+// evicts until bytes more fit next to the pinned entries, 0 when they do. Lets
+// the kernels check before packing an operand whole
+int cpu_pack_cache_reserve(PackCache* cache, size_t bytes);
+// 0 when packed is now owned by the cache, -1 when it doesn't fit the budget
+// (the caller keeps it)
+int cpu_pack_cache_insert(PackCache* cache, const PackKey* key, GemmPackedB* packed);
+
+#endif
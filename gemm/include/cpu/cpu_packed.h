@@ -0,0 +1,41 @@
+#ifndef CPU_PACKED_H
+#define CPU_PACKED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+
+typedef enum {
+	GEMM_ROW_MAJOR,
+	GEMM_COL_MAJOR,
+} GemmLayout;
+
+typedef enum {
+	GEMM_NO_TRANS,
+	GEMM_TRANS,
+} GemmTranspose;
+
+// a (nk, nj) B already in the micro-panel order of the BLIS kernel of the
+// build that packed it (see gemm_pack_b in cpu/cpu_gemm.h), so gemm_compute can
+// skip packing B. The fields are private to the kernels
+typedef struct {
+	uint32_t nk;
+	uint32_t nj;
+	uint32_t kc; // blocking B was packed with: KC x NC blocks of KC x NR micro-panels
+	uint32_t nc;
+	uint32_t nr;
+	dtype_t* panels; // from cpu_alloc, NC blocks one after the other, KC blocks inside them
+} GemmPackedB;
+
+// NULL when out of memory
+GemmPackedB* cpu_packed_b_create(uint32_t nk, uint32_t nj, uint32_t kc, uint32_t nc, uint32_t nr);
+void gemm_packed_b_free(GemmPackedB* packed);
+// memory taken by the panels
+size_t cpu_packed_b_bytes(const GemmPackedB* packed);
+// the same before packing, for a (nk, nj) B with the given NC and NR
+size_t cpu_packed_b_size(uint32_t nk, uint32_t nj, uint32_t nc, uint32_t nr);
+
+// start of the packed KC x NC block at (pc, jc), with J the width of its NC block
+dtype_t* cpu_packed_b_block(const GemmPackedB* packed, uint32_t pc, uint32_t jc, uint32_t J);
+
+#endif
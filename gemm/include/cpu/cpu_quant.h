@@ -0,0 +1,28 @@
+#ifndef CPU_QUANT_H
+#define CPU_QUANT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// affine int8 quantization: a real value x is stored as q = round(x / scale) +
+// zero_point, saturated, and read back as scale * (q - zero_point)
+
+// parameters of an int8 product C = A B (see gemm_rrc_u8s8_f32). The int32 sum
+// of (A - zero_a) (B - zero_b) is scaled back to a real value by the product of
+// the scales of A and B, per tensor or per column of C (per output channel)
+typedef struct {
+	int32_t zero_a; // zero point of A
+	const int32_t* zero_b; // zero point of B, NULL for symmetric B (zero_b = 0)
+	const float* scale; // scale of A times scale of B
+	const float* bias; // real value added to C, NULL for none
+	int per_channel; // zero_b, scale and bias have one entry per column of C, otherwise one
+	// int8 C only: its own scale and zero point
+	float scale_c;
+	int32_t zero_c;
+} GemmQuantization;
+
+// n values at a time, rounded to nearest even
+void cpu_quantize_u8(uint8_t* dst, const float* src, size_t n, float scale, int32_t zero_point);
+void cpu_quantize_s8(int8_t* dst, const float* src, size_t n, float scale, int32_t zero_point);
+
+#endif
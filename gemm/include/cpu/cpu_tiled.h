@@ -0,0 +1,42 @@
+#ifndef CPU_TILED_H
+#define CPU_TILED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "cpu/cpu_packed.h"
+
+// tiles have a multiple of this many rows and columns, so their rows start on
+// GEMM_ALIGNMENT boundaries and split evenly into the register tiles of the
+// kernels
+#define TILED_GRANULE 16
+
+// block-major matrix: (rows, cols) split into tile x tile tiles stored one
+// after the other, the tiles of a row of tiles next to each other, every tile
+// row major and zero-padded past the edges of the matrix. The layout the
+// blocked kernels pack into, so gemm_tiled can use the tiles as they are and
+// chained products can stay tiled from one to the next
+typedef struct {
+	uint32_t rows;
+	uint32_t cols;
+	uint32_t tile;
+	uint32_t tile_rows; // number of rows of tiles
+	uint32_t tile_cols; // number of tiles in a row of tiles
+	dtype_t* data; // from cpu_alloc
+} TiledMatrix;
+
+// zeroed (rows, cols) matrix, with tile rounded up to a multiple of
+// TILED_GRANULE (0 uses the blocksize of cpu_tuning()). NULL when out of memory
+TiledMatrix* cpu_tiled_create(uint32_t rows, uint32_t cols, uint32_t tile);
+void cpu_tiled_free(TiledMatrix* m);
+
+// converters from and to plain row or column major (rows, cols) arrays
+TiledMatrix* cpu_tiled_from(const dtype_t* src, uint32_t rows, uint32_t cols, GemmLayout layout, uint32_t tile);
+void cpu_tiled_to(const TiledMatrix* m, dtype_t* dst, GemmLayout layout);
+
+// first element of tile (ti, tj)
+static inline dtype_t* cpu_tiled_tile(const TiledMatrix* m, uint32_t ti, uint32_t tj) {
+	return m->data + ((size_t)ti * m->tile_cols + tj) * m->tile * m->tile;
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CPU_TUNE_H
+#define CPU_TUNE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// order of the two loops around the micro-kernel inside a MC x NC block
+typedef enum {
+	LOOP_ORDER_JR_IR, // a KC x NR micro-panel of B stays in L1 while A streams (BLIS)
+	LOOP_ORDER_IR_JR, // a MR x KC micro-panel of A stays in L1 while B streams
+} LoopOrder;
+
+typedef struct {
+	const char* name; // micro-kernel, e.g. "6x16_avx"
+	uint32_t mr;
+	uint32_t nr;
+	uint32_t mc;
+	uint32_t kc;
+	uint32_t nc;
+	LoopOrder order;
+	uint32_t unroll; // of the k loop of the micro-kernel: 1, 2 or 4
+} BlisTuning;
+
+#define N_BLIS_TUNINGS 4
+
+typedef struct {
+	uint32_t blocksize; // of the square blocked kernels
+	BlisTuning blis[N_BLIS_TUNINGS];
+	uint32_t strassen_cutoff; // gemm_rrc_strassen recurses while min(ni, nj, nk) is above it
+	int loaded; // 1 when the values above were read from (or saved to) a tuning file
+} GemmTuning;
+
+// tunable parameters of the CPU kernels, which read them on every call. They
+// start from the analytical model of cpu/cpu_cache.h and are overridden by the
+// tuning file (see cpu_tuning_path) on the first call, made by the load-time
+// constructors of the kernels
+GemmTuning* cpu_tuning(void);
+
+// index in GemmTuning.blis of the micro-kernel called name, -1 if there is no
+// such micro-kernel
+int cpu_tuning_blis(const char* name);
+
+// $GEMM_TUNING_FILE, or ~/.gemm_tuning when it is not set. NULL when
+// GEMM_TUNING_FILE is set to an empty string (tuning files disabled)
+const char* cpu_tuning_path(void);
+
+// files written for another CPU are ignored. Both return 0 on success
+int cpu_tuning_load(const char* path);
+int cpu_tuning_save(const char* path);
+
+// empirical search over block sizes, loop orders and unroll factors of the
+// kernels the host was bound to, timed on a few representative shapes. The
+// winners stay in cpu_tuning() and are saved to path. Progress goes to log.
+// Returns 1 when the operands can't be allocated or path can't be written
+int cpu_tune(const char* path, FILE* log);
+
+#endif
@@ -8,6 +8,8 @@ typedef struct {
 	WGPUAdapter adapter;
 	WGPUDevice device;
 	WGPUQueue queue;
+	// side of the square workgroup tile, the largest the device limits allow
+	uint32_t blocksize;
 	double time;
 } GPUData;
 
@@ -26,7 +26,7 @@ set style line 2 dt 2
 set style line 3 dt 3
 set style line 4 dt 4
 
-do for [i=1:20] {
+do for [i=1:24] {
     dt = (i-1) % dash_types + 1
     lw = word(widths, (i-1) % width_array + 1)
     set style line i lc i dt dt lw lw
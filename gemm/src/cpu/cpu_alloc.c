@@ -0,0 +1,198 @@
+// mmap flags and posix_memalign
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu/cpu_alloc.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// heap allocations keep their header in the GEMM_ALIGNMENT bytes before the
+// pointer returned to the caller. Mappings start right on their huge page, with
+// no room in front, so they are kept in a list instead (they are few and large).
+// Heap pointers are kept off huge page boundaries, which tells the two apart
+typedef struct {
+	void* base; // from posix_memalign
+} AllocHeader;
+
+#ifdef __linux__
+typedef struct Mapping {
+	void* p;
+	size_t map_size;
+	HugePages pages;
+	struct Mapping* next;
+} Mapping;
+
+static Mapping* mappings = NULL;
+#endif
+
+static pthread_once_t probed = PTHREAD_ONCE_INIT;
+static int explicit_available = 0;
+static int transparent_available = 0;
+
+static void probe(void) {
+	const char* env = getenv("GEMM_HUGE_PAGES");
+	if(env && !strcmp(env, "0")) {
+		return;
+	}
+#ifdef __linux__
+	char buf[64];
+	FILE* f = fopen("/sys/kernel/mm/hugepages/hugepages-2048kB/free_hugepages", "r");
+	if(f) {
+		explicit_available = fgets(buf, sizeof(buf), f) && atoi(buf) > 0;
+		fclose(f);
+	}
+	// "always [madvise] never", the bracketed one is the active mode
+	f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if(f) {
+		transparent_available = fgets(buf, sizeof(buf), f) && !strstr(buf, "[never]");
+		fclose(f);
+	}
+#endif
+}
+
+static int is_mapping(const void* p) {
+	return !((uintptr_t)p & (GEMM_HUGE_PAGE_SIZE - 1));
+}
+
+HugePages cpu_huge_pages(void) {
+	pthread_once(&probed, probe);
+	return explicit_available ? HUGE_PAGES_EXPLICIT : transparent_available ? HUGE_PAGES_TRANSPARENT : HUGE_PAGES_NONE;
+}
+
+const char* cpu_huge_pages_name(HugePages pages) {
+	switch(pages) {
+		case HUGE_PAGES_EXPLICIT: return "explicit huge pages";
+		case HUGE_PAGES_TRANSPARENT: return "transparent huge pages";
+		default: return "4 KiB pages";
+	}
+}
+
+#ifdef __linux__
+// adds the mapping to the list, or unmaps it when there is no memory for that
+static void* record(void* p, size_t map_size, HugePages pages) {
+	Mapping* m = malloc(sizeof(Mapping));
+	if(!m) {
+		munmap(p, map_size);
+		return NULL;
+	}
+	*m = (Mapping){ .p = p, .map_size = map_size, .pages = pages };
+	#pragma omp critical(cpu_alloc)
+	{
+		m->next = mappings;
+		mappings = m;
+	}
+	return p;
+}
+
+// the entry of the mapping at p, taken out of the list with unlink
+static Mapping* find(const void* p, int unlink) {
+	Mapping* m = NULL;
+	#pragma omp critical(cpu_alloc)
+	{
+		Mapping** link = &mappings;
+		while(*link && (*link)->p != p) link = &(*link)->next;
+		m = *link;
+		if(m && unlink) {
+			*link = m->next;
+		}
+	}
+	return m;
+}
+
+static void* map_huge(size_t size) {
+	size_t map_size = (size + GEMM_HUGE_PAGE_SIZE - 1) / GEMM_HUGE_PAGE_SIZE * GEMM_HUGE_PAGE_SIZE;
+	if(explicit_available) {
+		void* base = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(base != MAP_FAILED) {
+			return record(base, map_size, HUGE_PAGES_EXPLICIT);
+		}
+		// the reserved pages ran out
+	}
+	if(!transparent_available) {
+		return NULL;
+	}
+	// transparent huge pages need 2 MiB aligned ranges, so map one extra
+	// huge page and trim both ends down to the aligned range
+	size_t padded = map_size + GEMM_HUGE_PAGE_SIZE;
+	char* raw = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(raw == MAP_FAILED) {
+		return NULL;
+	}
+	char* base = (char*)(((uintptr_t)raw + GEMM_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(GEMM_HUGE_PAGE_SIZE - 1));
+	if(base > raw) {
+		munmap(raw, base - raw);
+	}
+	if(raw + padded > base + map_size) {
+		munmap(base + map_size, raw + padded - (base + map_size));
+	}
+	HugePages pages = madvise(base, map_size, MADV_HUGEPAGE) ? HUGE_PAGES_NONE : HUGE_PAGES_TRANSPARENT;
+	return record(base, map_size, pages);
+}
+#endif
+
+void* cpu_alloc(size_t size) {
+#ifdef __linux__
+	if(size >= GEMM_HUGE_PAGE_SIZE && cpu_huge_pages() != HUGE_PAGES_NONE) {
+		void* p = map_huge(size);
+		if(p) {
+			return p;
+		}
+	}
+#endif
+	// a cache line for the header, and one more to step off a huge page boundary
+	void* base = NULL;
+	if(posix_memalign(&base, GEMM_ALIGNMENT, size + 2 * GEMM_ALIGNMENT)) {
+		return NULL;
+	}
+	char* p = (char*)base + GEMM_ALIGNMENT;
+	if(is_mapping(p)) {
+		p += GEMM_ALIGNMENT;
+	}
+	((AllocHeader*)(p - GEMM_ALIGNMENT))->base = base;
+	return p;
+}
+
+void* cpu_calloc(size_t n, size_t size) {
+	// a wrapped n * size would give a buffer too small for n elements
+	if(size && n > SIZE_MAX / size) {
+		return NULL;
+	}
+	void* p = cpu_alloc(n * size);
+	// fresh mappings are zero already
+	if(p && !is_mapping(p)) {
+		memset(p, 0x00, n * size);
+	}
+	return p;
+}
+
+void cpu_free(void* p) {
+	if(!p) {
+		return;
+	}
+#ifdef __linux__
+	if(is_mapping(p)) {
+		Mapping* m = find(p, 1);
+		munmap(p, m->map_size);
+		free(m);
+		return;
+	}
+#endif
+	free(((AllocHeader*)((char*)p - GEMM_ALIGNMENT))->base);
+}
+
+HugePages cpu_alloc_pages(const void* p) {
+	if(!is_mapping(p)) {
+		return HUGE_PAGES_NONE;
+	}
+#ifdef __linux__
+	return find(p, 0)->pages;
+#else
+	return HUGE_PAGES_NONE;
+#endif
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <math.h>
+#include "cpu/cpu_cache.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+
+// upper bound for NC, past it the packed B buffer only grows (nj already fits)
+#define MAX_NC 8192
+#define MAX_MC 1024
+#define MAX_KC 1024
+
+static CacheInfo cache_info;
+static int probed = 0;
+
+static int read_sysfs(uint32_t index, const char* file, char* buf, int len) {
+	char path[128];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/%s", index, file);
+	FILE* f = fopen(path, "r");
+	if(!f) {
+		return 0;
+	}
+	int ok = fgets(buf, len, f) != NULL;
+	fclose(f);
+	return ok;
+}
+
+static uint32_t read_sysfs_uint(uint32_t index, const char* file) {
+	char buf[64];
+	if(!read_sysfs(index, file, buf, sizeof(buf))) {
+		return 0;
+	}
+	char unit = 0;
+	unsigned int value = 0;
+	if(sscanf(buf, "%u%c", &value, &unit) < 1) {
+		return 0;
+	}
+	if(unit == 'K') {
+		value *= 1024;
+	} else if(unit == 'M') {
+		value *= 1024 * 1024;
+	}
+	return value;
+}
+
+static CacheLevel* level_slot(CacheInfo* info, uint32_t level) {
+	switch(level) {
+		case 1: return &info->l1d;
+		case 2: return &info->l2;
+		case 3: return &info->l3;
+		default: return NULL;
+	}
+}
+
+static int probe_sysfs(CacheInfo* info) {
+	int found = 0;
+	for(uint32_t index = 0; index < 16; index++) {
+		char type[32];
+		if(!read_sysfs(index, "type", type, sizeof(type))) {
+			break;
+		}
+		// skip instruction caches
+		if(type[0] != 'D' && type[0] != 'U') {
+			continue;
+		}
+		CacheLevel* slot = level_slot(info, read_sysfs_uint(index, "level"));
+		if(!slot) {
+			continue;
+		}
+		slot->size = read_sysfs_uint(index, "size");
+		slot->ways = read_sysfs_uint(index, "ways_of_associativity");
+		slot->line_size = read_sysfs_uint(index, "coherency_line_size");
+		slot->sets = read_sysfs_uint(index, "number_of_sets");
+		found |= slot->size != 0;
+	}
+	return found;
+}
+
+static int probe_cpuid(CacheInfo* info) {
+#if defined(__x86_64__) || defined(__i386__)
+	// Intel exposes the deterministic cache parameters in leaf 4, AMD in
+	// 0x8000001D, both with the same layout
+	unsigned int leaves[] = { 4, 0x8000001D };
+	for(uint32_t l = 0; l < sizeof(leaves) / sizeof(leaves[0]); l++) {
+		if(__get_cpuid_max(leaves[l] & 0x80000000, NULL) < leaves[l]) {
+			continue;
+		}
+		int found = 0;
+		for(uint32_t sub = 0; sub < 16; sub++) {
+			unsigned int eax, ebx, ecx, edx;
+			__cpuid_count(leaves[l], sub, eax, ebx, ecx, edx);
+			uint32_t type = eax & 0x1F;
+			if(type == 0) {
+				break;
+			}
+			if(type == 2) {
+				continue;
+			}
+			CacheLevel* slot = level_slot(info, (eax >> 5) & 0x7);
+			if(!slot) {
+				continue;
+			}
+			slot->ways = ((ebx >> 22) & 0x3FF) + 1;
+			uint32_t partitions = ((ebx >> 12) & 0x3FF) + 1;
+			slot->line_size = (ebx & 0xFFF) + 1;
+			slot->sets = ecx + 1;
+			slot->size = slot->ways * partitions * slot->line_size * slot->sets;
+			found = 1;
+		}
+		if(found) {
+			return 1;
+		}
+	}
+#else
+	(void)info;
+#endif
+	return 0;
+}
+
+static void fill_level(CacheLevel* level, uint32_t size, uint32_t ways) {
+	if(!level->size) {
+		level->size = size;
+	}
+	if(!level->ways) {
+		level->ways = ways;
+	}
+	if(!level->line_size) {
+		level->line_size = 64;
+	}
+	if(!level->sets) {
+		level->sets = MAX(1, level->size / (level->ways * level->line_size));
+	}
+}
+
+const CacheInfo* cpu_cache_info(void) {
+	if(probed) {
+		return &cache_info;
+	}
+	CacheInfo info = {0};
+	if(!probe_sysfs(&info)) {
+		probe_cpuid(&info);
+	}
+	// whatever is still missing gets the values of a small desktop CPU
+	fill_level(&info.l1d, 32 * 1024, 8);
+	fill_level(&info.l2, 256 * 1024, 8);
+	fill_level(&info.l3, 8 * 1024 * 1024, 16);
+	cache_info = info;
+	probed = 1;
+	return &cache_info;
+}
+
+BlisBlocking cpu_blis_blocking(uint32_t mr, uint32_t nr, uint32_t element_size) {
+	const CacheInfo* info = cpu_cache_info();
+	const CacheLevel* l1 = &info->l1d;
+	const CacheLevel* l2 = &info->l2;
+	const CacheLevel* l3 = &info->l3;
+	BlisBlocking blocking;
+
+	// ways of L1 for the A micro-panel, B gets nr/mr times more and one way
+	// is left for C
+	uint32_t ways_a = MAX(1, (uint32_t)((l1->ways - 1) / (1.0 + (double)nr / mr)));
+	blocking.kc = ways_a * l1->sets * l1->line_size / (mr * element_size);
+	blocking.kc = MAX(16, MIN(MAX_KC, blocking.kc) / 8 * 8);
+
+	// ways of L2 taken by the B micro-panel, the A block gets the rest but one
+	uint32_t ways_b = (uint32_t)ceil((double)nr * blocking.kc * element_size / (l2->sets * l2->line_size));
+	uint32_t ways_l2 = l2->ways > ways_b + 1 ? l2->ways - ways_b - 1 : 1;
+	blocking.mc = (uint32_t)((uint64_t)ways_l2 * l2->sets * l2->line_size / (blocking.kc * element_size));
+	blocking.mc = MAX(mr, MIN(MAX_MC, blocking.mc) / mr * mr);
+
+	// same for the B block in L3 next to the A block
+	uint32_t ways_ac = (uint32_t)ceil((double)blocking.mc * blocking.kc * element_size / ((double)l3->sets * l3->line_size));
+	uint32_t ways_l3 = l3->ways > ways_ac + 1 ? l3->ways - ways_ac - 1 : 1;
+	uint64_t nc = (uint64_t)ways_l3 * l3->sets * l3->line_size / (blocking.kc * element_size);
+	blocking.nc = MAX(nr, (uint32_t)MIN(MAX_NC, nc) / nr * nr);
+	return blocking;
+}
+
+uint32_t cpu_square_blocking(uint32_t element_size) {
+	uint32_t size = (uint32_t)sqrt(cpu_cache_info()->l2.size / 4.0 / (3 * element_size));
+	return MAX(16, size - size % 16);
+}
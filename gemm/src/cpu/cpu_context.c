@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "cpu/cpu_context.h"
+
+GemmContext* cpu_context_create(uint32_t n_threads) {
+	GemmContext* ctx = malloc(sizeof(GemmContext));
+	if(!ctx) {
+		return NULL;
+	}
+	ctx->tuning = cpu_tuning();
+	ctx->n_threads = n_threads ? n_threads : (uint32_t)omp_get_max_threads();
+	ctx->workspaces = calloc(ctx->n_threads, sizeof(GemmWorkspace));
+	if(!ctx->workspaces) {
+		free(ctx);
+		return NULL;
+	}
+	cpu_pack_cache_init(&ctx->pack_cache, 0);
+	ctx->epoch = 0;
+	ctx->reproducible = cpu_reproducible();
+	return ctx;
+}
+
+void cpu_context_destroy(GemmContext* ctx) {
+	if(!ctx) {
+		return;
+	}
+	for(uint32_t i = 0; i < ctx->n_threads; i++) {
+		cpu_free(ctx->workspaces[i].block_a);
+		cpu_free(ctx->workspaces[i].block_b);
+	}
+	free(ctx->workspaces);
+	cpu_pack_cache_free(&ctx->pack_cache);
+	free(ctx);
+}
+
+void cpu_context_set_pack_cache(GemmContext* ctx, size_t budget) {
+	cpu_pack_cache_set_budget(&ctx->pack_cache, budget);
+}
+
+PackCacheStats cpu_context_pack_cache_stats(const GemmContext* ctx) {
+	return ctx->pack_cache.stats;
+}
+
+void cpu_context_set_reproducible(GemmContext* ctx, int reproducible) {
+	ctx->reproducible = reproducible;
+}
+
+int cpu_reproducible(void) {
+	const char* env = getenv("GEMM_REPRODUCIBLE");
+	return env && strcmp(env, "0");
+}
+
+static int reserve(dtype_t** buffer, size_t* capacity, size_t size) {
+	if(*capacity >= size) {
+		return 0;
+	}
+	cpu_free(*buffer);
+	*buffer = cpu_alloc(size * sizeof(dtype_t));
+	*capacity = *buffer ? size : 0;
+	return *buffer ? 0 : -1;
+}
+
+GemmWorkspace* cpu_workspace_acquire(GemmContext* ctx, uint32_t thread, size_t size_a, size_t size_b, GemmWorkspace* scratch) {
+	GemmWorkspace* ws = scratch;
+	if(ctx) {
+		ws = &ctx->workspaces[thread];
+	} else {
+		*scratch = (GemmWorkspace){0};
+	}
+	if(reserve(&ws->block_a, &ws->size_a, size_a) || reserve(&ws->block_b, &ws->size_b, size_b)) {
+		cpu_workspace_release(ws, scratch);
+		return NULL;
+	}
+	return ws;
+}
+
+void cpu_workspace_release(GemmWorkspace* ws, GemmWorkspace* scratch) {
+	if(ws == scratch) {
+		cpu_free(ws->block_a);
+		cpu_free(ws->block_b);
+	}
+}
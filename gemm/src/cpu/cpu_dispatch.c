@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cpu/cpu_gemm.h"
+#include "cpu/cpu_dispatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// the builds of cpu_gemm.c
+#define DECLARE_ISA_BUILDS(name) \
+	void name##_isa_scalar(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk); \
+	void name##_isa_sse2(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk); \
+	void name##_isa_avx2(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk); \
+	void name##_isa_avx512(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk);
+CPU_GEMM_KERNELS(DECLARE_ISA_BUILDS)
+
+// the public symbols jump through a pointer that is bound once at load time
+#define DEFINE_ENTRY_POINT(name) \
+	static GemmKernel name##_impl = name##_isa_scalar; \
+	void name(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) { \
+		name##_impl(userdata, C, A, B, ni, nj, nk); \
+	}
+CPU_GEMM_KERNELS(DEFINE_ENTRY_POINT)
+
+// same for the functions of CPU_GEMM_OTHER_FUNCTIONS, one by one
+#define DECLARE_OTHER_ISA_BUILDS(isa) \
+	void gemm_blas_isa_##isa(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, dtype_t alpha, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, dtype_t beta, dtype_t* C, uint32_t ldc); \
+	GemmPackedB* gemm_pack_b_isa_##isa(void* userdata, dtype_t* B, uint32_t nk, uint32_t nj, GemmLayout layout); \
+	void gemm_compute_isa_##isa(void* userdata, dtype_t* C, dtype_t* A, const GemmPackedB* B, uint32_t ni); \
+	void gemm_ttt_tiled_isa_##isa(void* userdata, TiledMatrix* C, const TiledMatrix* A, const TiledMatrix* B); \
+	void gemm_rtt_tiled_isa_##isa(void* userdata, dtype_t* C, const TiledMatrix* A, const TiledMatrix* B); \
+	void gemv_r_isa_##isa(void* userdata, dtype_t* y, dtype_t* A, dtype_t* x, uint32_t ni, uint32_t nk); \
+	void gemv_c_isa_##isa(void* userdata, dtype_t* y, dtype_t* A, dtype_t* x, uint32_t ni, uint32_t nk); \
+	void gemm_blas_f64_isa_##isa(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, double alpha, double* A, uint32_t lda, double* B, uint32_t ldb, double beta, double* C, uint32_t ldc); \
+	void gemm_blas_bf16_isa_##isa(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, float alpha, bf16_t* A, uint32_t lda, bf16_t* B, uint32_t ldb, float beta, float* C, uint32_t ldc); \
+	void gemm_blas_f16_isa_##isa(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, float alpha, f16_t* A, uint32_t lda, f16_t* B, uint32_t ldb, float beta, float* C, uint32_t ldc); \
+	void gemm_rrc_u8s8_f32_isa_##isa(void* userdata, uint32_t ni, uint32_t nj, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, float* C, uint32_t ldc); \
+	void gemm_rrc_u8s8_s8_isa_##isa(void* userdata, uint32_t ni, uint32_t nj, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, int8_t* C, uint32_t ldc);
+DECLARE_OTHER_ISA_BUILDS(scalar)
+DECLARE_OTHER_ISA_BUILDS(sse2)
+DECLARE_OTHER_ISA_BUILDS(avx2)
+DECLARE_OTHER_ISA_BUILDS(avx512)
+
+static void (*gemm_blas_impl)(void*, GemmLayout, GemmTranspose, GemmTranspose, uint32_t, uint32_t, uint32_t, dtype_t, dtype_t*, uint32_t, dtype_t*, uint32_t, dtype_t, dtype_t*, uint32_t) = gemm_blas_isa_scalar;
+void gemm_blas(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, dtype_t alpha, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, dtype_t beta, dtype_t* C, uint32_t ldc) {
+	gemm_blas_impl(userdata, layout, trans_a, trans_b, ni, nj, nk, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+static GemmPackedB* (*gemm_pack_b_impl)(void*, dtype_t*, uint32_t, uint32_t, GemmLayout) = gemm_pack_b_isa_scalar;
+GemmPackedB* gemm_pack_b(void* userdata, dtype_t* B, uint32_t nk, uint32_t nj, GemmLayout layout) {
+	return gemm_pack_b_impl(userdata, B, nk, nj, layout);
+}
+
+static void (*gemm_compute_impl)(void*, dtype_t*, dtype_t*, const GemmPackedB*, uint32_t) = gemm_compute_isa_scalar;
+void gemm_compute(void* userdata, dtype_t* C, dtype_t* A, const GemmPackedB* B, uint32_t ni) {
+	gemm_compute_impl(userdata, C, A, B, ni);
+}
+
+static void (*gemm_ttt_tiled_impl)(void*, TiledMatrix*, const TiledMatrix*, const TiledMatrix*) = gemm_ttt_tiled_isa_scalar;
+void gemm_ttt_tiled(void* userdata, TiledMatrix* C, const TiledMatrix* A, const TiledMatrix* B) {
+	gemm_ttt_tiled_impl(userdata, C, A, B);
+}
+
+static void (*gemm_rtt_tiled_impl)(void*, dtype_t*, const TiledMatrix*, const TiledMatrix*) = gemm_rtt_tiled_isa_scalar;
+void gemm_rtt_tiled(void* userdata, dtype_t* C, const TiledMatrix* A, const TiledMatrix* B) {
+	gemm_rtt_tiled_impl(userdata, C, A, B);
+}
+
+static void (*gemv_r_impl)(void*, dtype_t*, dtype_t*, dtype_t*, uint32_t, uint32_t) = gemv_r_isa_scalar;
+void gemv_r(void* userdata, dtype_t* y, dtype_t* A, dtype_t* x, uint32_t ni, uint32_t nk) {
+	gemv_r_impl(userdata, y, A, x, ni, nk);
+}
+
+static void (*gemv_c_impl)(void*, dtype_t*, dtype_t*, dtype_t*, uint32_t, uint32_t) = gemv_c_isa_scalar;
+void gemv_c(void* userdata, dtype_t* y, dtype_t* A, dtype_t* x, uint32_t ni, uint32_t nk) {
+	gemv_c_impl(userdata, y, A, x, ni, nk);
+}
+
+// dtype_t is float, so fp32 has a single driver, the one of gemm_blas
+void gemm_blas_f32(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, float alpha, float* A, uint32_t lda, float* B, uint32_t ldb, float beta, float* C, uint32_t ldc) {
+	gemm_blas_impl(userdata, layout, trans_a, trans_b, ni, nj, nk, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+static void (*gemm_blas_f64_impl)(void*, GemmLayout, GemmTranspose, GemmTranspose, uint32_t, uint32_t, uint32_t, double, double*, uint32_t, double*, uint32_t, double, double*, uint32_t) = gemm_blas_f64_isa_scalar;
+void gemm_blas_f64(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, double alpha, double* A, uint32_t lda, double* B, uint32_t ldb, double beta, double* C, uint32_t ldc) {
+	gemm_blas_f64_impl(userdata, layout, trans_a, trans_b, ni, nj, nk, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+static void (*gemm_blas_bf16_impl)(void*, GemmLayout, GemmTranspose, GemmTranspose, uint32_t, uint32_t, uint32_t, float, bf16_t*, uint32_t, bf16_t*, uint32_t, float, float*, uint32_t) = gemm_blas_bf16_isa_scalar;
+void gemm_blas_bf16(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, float alpha, bf16_t* A, uint32_t lda, bf16_t* B, uint32_t ldb, float beta, float* C, uint32_t ldc) {
+	gemm_blas_bf16_impl(userdata, layout, trans_a, trans_b, ni, nj, nk, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+static void (*gemm_blas_f16_impl)(void*, GemmLayout, GemmTranspose, GemmTranspose, uint32_t, uint32_t, uint32_t, float, f16_t*, uint32_t, f16_t*, uint32_t, float, float*, uint32_t) = gemm_blas_f16_isa_scalar;
+void gemm_blas_f16(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, float alpha, f16_t* A, uint32_t lda, f16_t* B, uint32_t ldb, float beta, float* C, uint32_t ldc) {
+	gemm_blas_f16_impl(userdata, layout, trans_a, trans_b, ni, nj, nk, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+static void (*gemm_rrc_u8s8_f32_impl)(void*, uint32_t, uint32_t, uint32_t, const uint8_t*, uint32_t, const int8_t*, uint32_t, const GemmQuantization*, float*, uint32_t) = gemm_rrc_u8s8_f32_isa_scalar;
+void gemm_rrc_u8s8_f32(void* userdata, uint32_t ni, uint32_t nj, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, float* C, uint32_t ldc) {
+	gemm_rrc_u8s8_f32_impl(userdata, ni, nj, nk, A, lda, B, ldb, q, C, ldc);
+}
+
+static void (*gemm_rrc_u8s8_s8_impl)(void*, uint32_t, uint32_t, uint32_t, const uint8_t*, uint32_t, const int8_t*, uint32_t, const GemmQuantization*, int8_t*, uint32_t) = gemm_rrc_u8s8_s8_isa_scalar;
+void gemm_rrc_u8s8_s8(void* userdata, uint32_t ni, uint32_t nj, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, int8_t* C, uint32_t ldc) {
+	gemm_rrc_u8s8_s8_impl(userdata, ni, nj, nk, A, lda, B, ldb, q, C, ldc);
+}
+
+static CpuIsa bound_isa = CPU_ISA_SCALAR;
+
+static const char* isa_names[] = {
+	[CPU_ISA_SCALAR] = "scalar",
+	[CPU_ISA_SSE2] = "sse2",
+	[CPU_ISA_AVX2] = "avx2",
+	[CPU_ISA_AVX512] = "avx512",
+};
+
+const char* cpu_isa_name(CpuIsa isa) {
+	return isa_names[isa];
+}
+
+CpuIsa cpu_isa(void) {
+	return bound_isa;
+}
+
+CpuIsa cpu_isa_detect(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int eax, ebx, ecx, edx;
+	if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(edx & bit_SSE2)) {
+		return CPU_ISA_SCALAR;
+	}
+	// the OS must save the ymm/zmm registers on context switches too
+	// (F16C came with FMA, the AVX2 builds use both)
+	if(!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX) || !(ecx & bit_FMA) || !(ecx & bit_F16C)) {
+		return CPU_ISA_SSE2;
+	}
+	unsigned int xcr0_lo, xcr0_hi;
+	__asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+	(void)xcr0_hi;
+	if((xcr0_lo & 0x6) != 0x6) {
+		return CPU_ISA_SSE2;
+	}
+	if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_AVX2)) {
+		return CPU_ISA_SSE2;
+	}
+	// opmask, upper halves of zmm0-15 and zmm16-31
+	if(!(ebx & bit_AVX512F) || (xcr0_lo & 0xE0) != 0xE0) {
+		return CPU_ISA_AVX2;
+	}
+	return CPU_ISA_AVX512;
+#else
+	return CPU_ISA_SCALAR;
+#endif
+}
+
+// AVX512-VNNI, which the AVX-512 build of the int8 kernels also uses
+static int cpu_has_avx512_vnni(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int eax, ebx, ecx, edx;
+	return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ecx & bit_AVX512VNNI);
+#else
+	return 0;
+#endif
+}
+
+#define BIND(name, isa) name##_impl = name##_isa_##isa;
+#define BIND_SCALAR(name) BIND(name, scalar)
+#define BIND_SSE2(name) BIND(name, sse2)
+#define BIND_AVX2(name) BIND(name, avx2)
+#define BIND_AVX512(name) BIND(name, avx512)
+
+__attribute__((constructor)) static void cpu_dispatch_init(void) {
+	bound_isa = cpu_isa_detect();
+	const char* forced = getenv("GEMM_ISA");
+	for(CpuIsa isa = CPU_ISA_SCALAR; forced && isa < bound_isa; isa++) {
+		if(!strcmp(forced, isa_names[isa])) {
+			bound_isa = isa;
+		}
+	}
+	switch(bound_isa) {
+		case CPU_ISA_SCALAR: CPU_GEMM_KERNELS(BIND_SCALAR) CPU_GEMM_OTHER_FUNCTIONS(BIND_SCALAR) break;
+		case CPU_ISA_SSE2: CPU_GEMM_KERNELS(BIND_SSE2) CPU_GEMM_OTHER_FUNCTIONS(BIND_SSE2) break;
+		case CPU_ISA_AVX2: CPU_GEMM_KERNELS(BIND_AVX2) CPU_GEMM_OTHER_FUNCTIONS(BIND_AVX2) break;
+		case CPU_ISA_AVX512: CPU_GEMM_KERNELS(BIND_AVX512) CPU_GEMM_OTHER_FUNCTIONS(BIND_AVX512) break;
+	}
+	if(bound_isa == CPU_ISA_AVX512 && !cpu_has_avx512_vnni()) {
+		BIND(gemm_rrc_u8s8_f32, avx2)
+		BIND(gemm_rrc_u8s8_s8, avx2)
+	}
+}
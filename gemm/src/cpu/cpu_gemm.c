@@ -1,13 +1,135 @@
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <omp.h>
 #include<immintrin.h>
 #include "cpu/cpu_gemm.h"
+#include "cpu/cpu_tune.h"
+#include "cpu/cpu_context.h"
+#include "cpu/cpu_jit.h"
 
-#define MIN(a, b) (a < b ? a : b);
-#define MAX(a, b) (a < b ? b : a);
+// this file is compiled once per instruction set (see ISAS in the Makefile)
+// and src/cpu/cpu_dispatch.c binds the public symbols at load time. The
+// scalar build ignores the SSE2 baseline of x86-64 on purpose
+#ifndef GEMM_SCALAR
+#if defined(__SSE2__)
+#define HAVE_SSE2
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+#define HAVE_AVX2
+#endif
+#if defined(__AVX512F__)
+#define HAVE_AVX512
+#endif
+#endif
 
-#define BLOCKSIZE 64
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+
+// packed blocks have their leading dimension rounded up to PACK_ALIGN elements,
+// so with the GEMM_ALIGNMENT aligned workspaces every packed row is aligned
+#define PACK_ALIGN (GEMM_ALIGNMENT / sizeof(dtype_t))
+#define ALIGN_UP(x, n) (((x) + (n) - 1) / (n) * (n))
+
+// parameters of a call: the ones of its context, or the process-wide ones
+static inline const GemmTuning* tuning_of(GemmContext* ctx) {
+	return ctx ? ctx->tuning : cpu_tuning();
+}
+
+#ifdef HAVE_AVX2
+// lanes [0, n) set, for maskload/maskstore
+static inline __m256i mask_avx(uint32_t n) {
+	return _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+static inline void transpose_8x8_avx(__m256* r) {
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+#endif
+
+// dst[c * ldd + r] = src[r * lds + c] for a (rows, cols) block of src. The AVX
+// builds go through 8x8 tiles transposed in registers, using masked loads and
+// stores for the edge tiles, SSE2 through 4x4 tiles with scalar edges
+static void transpose_block(dtype_t* dst, uint32_t ldd, dtype_t* src, uint32_t lds, uint32_t rows, uint32_t cols) {
+#if defined(HAVE_AVX2)
+	for(uint32_t r = 0; r < rows; r += 8) {
+		uint32_t R = MIN(8, rows - r);
+		for(uint32_t c = 0; c < cols; c += 8) {
+			uint32_t C = MIN(8, cols - c);
+			__m256 tile[8];
+			if(R == 8 && C == 8) {
+				for(uint32_t i = 0; i < 8; i++) tile[i] = _mm256_loadu_ps(&src[(r + i) * lds + c]);
+				transpose_8x8_avx(tile);
+				for(uint32_t i = 0; i < 8; i++) _mm256_storeu_ps(&dst[(c + i) * ldd + r], tile[i]);
+			} else {
+				__m256i load_mask = mask_avx(C);
+				__m256i store_mask = mask_avx(R);
+				for(uint32_t i = 0; i < 8; i++) {
+					tile[i] = i < R ? _mm256_maskload_ps(&src[(r + i) * lds + c], load_mask) : _mm256_setzero_ps();
+				}
+				transpose_8x8_avx(tile);
+				for(uint32_t i = 0; i < C; i++) _mm256_maskstore_ps(&dst[(c + i) * ldd + r], store_mask, tile[i]);
+			}
+		}
+	}
+#else
+	uint32_t r = 0;
+#if defined(HAVE_SSE2)
+	for(; r + 4 <= rows; r += 4) {
+		uint32_t c = 0;
+		for(; c + 4 <= cols; c += 4) {
+			__m128 r0 = _mm_loadu_ps(&src[(r + 0) * lds + c]);
+			__m128 r1 = _mm_loadu_ps(&src[(r + 1) * lds + c]);
+			__m128 r2 = _mm_loadu_ps(&src[(r + 2) * lds + c]);
+			__m128 r3 = _mm_loadu_ps(&src[(r + 3) * lds + c]);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(&dst[(c + 0) * ldd + r], r0);
+			_mm_storeu_ps(&dst[(c + 1) * ldd + r], r1);
+			_mm_storeu_ps(&dst[(c + 2) * ldd + r], r2);
+			_mm_storeu_ps(&dst[(c + 3) * ldd + r], r3);
+		}
+		for(; c < cols; c++) {
+			for(uint32_t i = 0; i < 4; i++) dst[c * ldd + r + i] = src[(r + i) * lds + c];
+		}
+	}
+#endif
+	for(; r < rows; r++) {
+		for(uint32_t c = 0; c < cols; c++) dst[c * ldd + r] = src[r * lds + c];
+	}
+#endif
+}
+
+// zeroes columns [cols, width) of the rows of dst, the lanes past the edge of
+// a transposed block that full-vector loops load. Whatever was left there
+// (stack or fresh heap) could hold denormals or NaNs, whose FP assists cost
+// more than the whole product
+static void zero_tail(dtype_t* dst, uint32_t ldd, uint32_t rows, uint32_t cols, uint32_t width) {
+	for(uint32_t r = 0; cols < width && r < rows; r++) memset(&dst[r * ldd + cols], 0, (width - cols) * sizeof(dtype_t));
+}
 
 void gemm_rrc_naive(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
 	// C is row major
@@ -23,16 +145,17 @@ void gemm_rrc_naive(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, ui
 	}
 }
 
-void gemm_rrc_blocked_without_packing(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+void gemm_rrc_blocked_without_packing(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
 	// C is row major
 	// A is row major
 	// B is column major
-	for(uint32_t bi = 0; bi < ni; bi += BLOCKSIZE) {
-		uint32_t I = MIN(BLOCKSIZE, ni - bi);
-		for(uint32_t bj = 0; bj < nj; bj += BLOCKSIZE) {
-			uint32_t J = MIN(BLOCKSIZE, nj - bj);
-			for(uint32_t bk = 0; bk < nk; bk += BLOCKSIZE) {
-				uint32_t K = MIN(BLOCKSIZE, nk - bk);
+	uint32_t blocksize = tuning_of(userdata)->blocksize;
+	for(uint32_t bi = 0; bi < ni; bi += blocksize) {
+		uint32_t I = MIN(blocksize, ni - bi);
+		for(uint32_t bj = 0; bj < nj; bj += blocksize) {
+			uint32_t J = MIN(blocksize, nj - bj);
+			for(uint32_t bk = 0; bk < nk; bk += blocksize) {
+				uint32_t K = MIN(blocksize, nk - bk);
 				for(uint32_t ii = 0; ii < I; ii++) {
 					for(uint32_t ij = 0; ij < J; ij++) {
 						for(uint32_t ik = 0; ik < K; ik++) {
@@ -50,23 +173,31 @@ void gemm_rrc_blocked_without_packing(void* _, dtype_t* C, dtype_t* A, dtype_t*
 }
 
 
-void gemm_rrc_blocked(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+void gemm_rrc_blocked(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
 	// C is row major
 	// A is row major
 	// B is column major
-	dtype_t* block_a = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
-	dtype_t* block_b = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
+	uint32_t blocksize = tuning_of(userdata)->blocksize;
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(userdata, 0, blocksize * blocksize, blocksize * blocksize, &scratch);
+	if(!ws) {
+		// out of memory: the same blocking without the packed copies
+		gemm_rrc_blocked_without_packing(userdata, C, A, B, ni, nj, nk);
+		return;
+	}
+	dtype_t* block_a = ws->block_a;
+	dtype_t* block_b = ws->block_b;
 
-	for(uint32_t bi = 0; bi < ni; bi += BLOCKSIZE) {
-		uint32_t I = MIN(BLOCKSIZE, ni - bi);
-		for(uint32_t bk = 0; bk < nk; bk += BLOCKSIZE) {
-			uint32_t K = MIN(BLOCKSIZE, nk - bk);
+	for(uint32_t bi = 0; bi < ni; bi += blocksize) {
+		uint32_t I = MIN(blocksize, ni - bi);
+		for(uint32_t bk = 0; bk < nk; bk += blocksize) {
+			uint32_t K = MIN(blocksize, nk - bk);
 			// --- Pack A block (row-major) ---
 			for(uint32_t ii = 0; ii < I; ii++) {
 				memcpy(&block_a[ii * K], &A[(bi + ii) * nk + bk], K * sizeof(dtype_t));
 			}
-			for(uint32_t bj = 0; bj < nj; bj += BLOCKSIZE) {
-				uint32_t J = MIN(BLOCKSIZE, nj - bj);
+			for(uint32_t bj = 0; bj < nj; bj += blocksize) {
+				uint32_t J = MIN(blocksize, nj - bj);
 				// --- Pack B block (column-major) ---
 				for(uint32_t ij = 0; ij < J; ij++) {
 					memcpy(&block_b[ij * K], &B[bk + (bj + ij) * nk], K * sizeof(dtype_t));
@@ -82,131 +213,192 @@ void gemm_rrc_blocked(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni,
 			}
 		}
 	}
-	free(block_a);
-	free(block_b);
+	cpu_workspace_release(ws, &scratch);
 }
 
-void gemm_ccr_blocked_avx(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+void gemm_ccr_blocked_avx(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
 	// C is (ni, nj)
 	// A is (ni, nk)
 	// B is (nk, nj)
+	uint32_t blocksize = tuning_of(userdata)->blocksize;
+#ifdef HAVE_AVX2
 	uint8_t n_avx = 32 / sizeof(dtype_t);
-	dtype_t* block_a = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
-	dtype_t* block_b = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
-	for(uint32_t bk = 0; bk < nk; bk += BLOCKSIZE) {
-		uint32_t K = MIN(BLOCKSIZE, nk - bk);
-		for(uint32_t bj = 0; bj < nj; bj += BLOCKSIZE) {
-			uint32_t J = MIN(BLOCKSIZE, nj - bj);
+#endif
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(userdata, 0, blocksize * ALIGN_UP(blocksize, PACK_ALIGN), blocksize * blocksize, &scratch);
+	if(!ws) {
+		// out of memory: the same product without packing
+		for(uint32_t j = 0; j < nj; j++) {
+			for(uint32_t k = 0; k < nk; k++) {
+				for(uint32_t i = 0; i < ni; i++) C[j * nj + i] += B[k * nj + j] * A[k * ni + i];
+			}
+		}
+		return;
+	}
+	dtype_t* block_a = ws->block_a;
+	dtype_t* block_b = ws->block_b;
+	for(uint32_t bk = 0; bk < nk; bk += blocksize) {
+		uint32_t K = MIN(blocksize, nk - bk);
+		for(uint32_t bj = 0; bj < nj; bj += blocksize) {
+			uint32_t J = MIN(blocksize, nj - bj);
 			// --- Pack B block (maintaining row-major) ---
 			for(uint32_t ik = 0; ik < K; ik++) {
 				memcpy(&block_b[ik * J], &B[(bk + ik) * nj + bj], J * sizeof(dtype_t));
 			}
-			for(uint32_t bi = 0; bi < ni; bi += BLOCKSIZE) {
-				uint32_t I = MIN(BLOCKSIZE, ni - bi);
+			for(uint32_t bi = 0; bi < ni; bi += blocksize) {
+				uint32_t I = MIN(blocksize, ni - bi);
+				uint32_t ld_a = ALIGN_UP(I, PACK_ALIGN);
 				// --- Pack A block (maintaining column-major) ---
 				for(uint32_t ik = 0; ik < K; ik++) {
-					memcpy(&block_a[ik * I], &A[(bk + ik) * ni + bi], I * sizeof(dtype_t));
+					memcpy(&block_a[ik * ld_a], &A[(bk + ik) * ni + bi], I * sizeof(dtype_t));
 				}
 
 				for(uint32_t ij = 0; ij < J; ij++) {
 					for(uint32_t ik = 0; ik < K; ik++) {
 						uint64_t ii = 0;
-						uint32_t aligned_I = I > n_avx ? I - n_avx + 1 : 0;
-						for ( ii = 0; ii < aligned_I; ii += n_avx ){
+#ifdef HAVE_AVX2
+						__m256 b_scalar = _mm256_set1_ps(block_b[ik * J + ij]);
+						for ( ii = 0; ii + n_avx <= I; ii += n_avx ){
 							uint32_t c_index = (bj + ij) * nj + (bi + ii);
-							__m256 a_vec = _mm256_loadu_ps(&block_a[ik * I + ii]);
-							__m256 b_scalar = _mm256_set1_ps(block_b[ik * J + ij]);
+							__m256 a_vec = _mm256_load_ps(&block_a[ik * ld_a + ii]);
 							__m256 c_vec = _mm256_loadu_ps(&C[c_index]);
 							c_vec = _mm256_fmadd_ps(a_vec, b_scalar, c_vec);
 							_mm256_storeu_ps(&C[c_index], c_vec);
 						}
-						for (; ii < I; ii++) C[(bj + ij) * nj + (bi + ii)] += block_b[ik * J + ij] * block_a[ik * I + ii];
+						// ragged end of the column with masked loads and stores
+						if(ii < I) {
+							uint32_t c_index = (bj + ij) * nj + (bi + ii);
+							__m256i tail = mask_avx(I - ii);
+							__m256 a_vec = _mm256_maskload_ps(&block_a[ik * ld_a + ii], tail);
+							__m256 c_vec = _mm256_maskload_ps(&C[c_index], tail);
+							c_vec = _mm256_fmadd_ps(a_vec, b_scalar, c_vec);
+							_mm256_maskstore_ps(&C[c_index], tail, c_vec);
+							ii = I;
+						}
+#endif
+						for (; ii < I; ii++) C[(bj + ij) * nj + (bi + ii)] += block_b[ik * J + ij] * block_a[ik * ld_a + ii];
 					}
 				}
 			}
 		}
 	}
-	free(block_a);
-	free(block_b);
+	cpu_workspace_release(ws, &scratch);
 }
 
-void gemm_rrc_to_rrr_blocked_avx(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+void gemm_rrc_to_rrr_blocked_avx(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
 	// C is (ni, nj)
 	// A is (ni, nk)
 	// B is (nk, nj)
+	uint32_t blocksize = tuning_of(userdata)->blocksize;
+#ifdef HAVE_AVX2
 	uint8_t n_avx = 32 / sizeof(dtype_t);
-	dtype_t* block_a = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
-	dtype_t* block_b = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
-	for(uint32_t bi = 0; bi < ni; bi += BLOCKSIZE) {
-		uint32_t I = MIN(BLOCKSIZE, ni - bi);
-		for(uint32_t bk = 0; bk < nk; bk += BLOCKSIZE) {
-			uint32_t K = MIN(BLOCKSIZE, nk - bk);
+#endif
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(userdata, 0, blocksize * blocksize, blocksize * ALIGN_UP(blocksize, PACK_ALIGN), &scratch);
+	if(!ws) {
+		// out of memory: the same blocking without the packed copies
+		gemm_rrc_blocked_without_packing(userdata, C, A, B, ni, nj, nk);
+		return;
+	}
+	dtype_t* block_a = ws->block_a;
+	dtype_t* block_b = ws->block_b;
+	for(uint32_t bi = 0; bi < ni; bi += blocksize) {
+		uint32_t I = MIN(blocksize, ni - bi);
+		for(uint32_t bk = 0; bk < nk; bk += blocksize) {
+			uint32_t K = MIN(blocksize, nk - bk);
 			// --- Pack A block (maintaining row-major) ---
 			for(uint32_t ii = 0; ii < I; ii++) {
 				memcpy(&block_a[ii * K], &A[(bi + ii) * nk + bk], K * sizeof(dtype_t));
 			}
-			for(uint32_t bj = 0; bj < nj; bj += BLOCKSIZE) {
-				uint32_t J = MIN(BLOCKSIZE, nj - bj);
+			for(uint32_t bj = 0; bj < nj; bj += blocksize) {
+				uint32_t J = MIN(blocksize, nj - bj);
+				uint32_t ld_b = ALIGN_UP(J, PACK_ALIGN);
 				// --- Pack B block (converting to row-major) ---
-				for(uint32_t ik = 0; ik < K; ik++) {
-					for(uint32_t ij = 0; ij < J; ij++) {
-						block_b[ik * J + ij] = B[(bj + ij) * nk + (bk + ik)];
-					}
-				}
+				transpose_block(block_b, ld_b, &B[bj * nk + bk], nk, J, K);
 				for (uint32_t ii = 0; ii < I; ii ++){
 					for(uint32_t ik = 0; ik < K; ik ++) {
 						uint64_t ij = 0;
-						uint32_t aligned_J = J > n_avx ? J - n_avx + 1 : 0;
-						for(ij = 0; ij < aligned_J; ij+=n_avx) {
+#ifdef HAVE_AVX2
+						__m256 a_scalar = _mm256_set1_ps(block_a[ii * K + ik]);
+						for(ij = 0; ij + n_avx <= J; ij+=n_avx) {
 							uint32_t c_index = (bi + ii) * nj + (bj + ij);
-							__m256 a_scalar = _mm256_set1_ps(block_a[ii * K + ik]);
-							__m256 b_vec = _mm256_loadu_ps(&block_b[ik * J + ij]);
+							__m256 b_vec = _mm256_load_ps(&block_b[ik * ld_b + ij]);
 							__m256 c_vec = _mm256_loadu_ps(&C[c_index]);
 							c_vec = _mm256_fmadd_ps(a_scalar, b_vec, c_vec);
 							_mm256_storeu_ps(&C[c_index], c_vec);
 						}
-						for (; ij < J; ij++) C[(bi + ii) * nj + (bj + ij)] += block_b[ik * J + ij] * block_a[ii * K + ik];
+						// ragged end of the row with masked loads and stores
+						if(ij < J) {
+							uint32_t c_index = (bi + ii) * nj + (bj + ij);
+							__m256i tail = mask_avx(J - ij);
+							__m256 b_vec = _mm256_maskload_ps(&block_b[ik * ld_b + ij], tail);
+							__m256 c_vec = _mm256_maskload_ps(&C[c_index], tail);
+							c_vec = _mm256_fmadd_ps(a_scalar, b_vec, c_vec);
+							_mm256_maskstore_ps(&C[c_index], tail, c_vec);
+							ij = J;
+						}
+#endif
+						for (; ij < J; ij++) C[(bi + ii) * nj + (bj + ij)] += block_b[ik * ld_b + ij] * block_a[ii * K + ik];
 					}
 				}
 			}
 		}
 	}
-	free(block_a);
-	free(block_b);
+	cpu_workspace_release(ws, &scratch);
 }
 
-void gemm_rrc_blocked_avx(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+void gemm_rrc_blocked_avx(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
 	// C is (ni, nj)
 	// A is (ni, nk)
 	// B is (nk, nj)
+	uint32_t blocksize = tuning_of(userdata)->blocksize;
+#ifdef HAVE_AVX2
 	uint8_t n_avx = 32 / sizeof(dtype_t);
-	dtype_t* block_a = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
-	dtype_t* block_b = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
-	for(uint32_t bi = 0; bi < ni; bi += BLOCKSIZE) {
-		uint32_t I = MIN(BLOCKSIZE, ni - bi);
-		for(uint32_t bk = 0; bk < nk; bk += BLOCKSIZE) {
-			uint32_t K = MIN(BLOCKSIZE, nk - bk);
+#endif
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(userdata, 0, blocksize * ALIGN_UP(blocksize, PACK_ALIGN), blocksize * ALIGN_UP(blocksize, PACK_ALIGN), &scratch);
+	if(!ws) {
+		// out of memory: the same blocking without the packed copies
+		gemm_rrc_blocked_without_packing(userdata, C, A, B, ni, nj, nk);
+		return;
+	}
+	dtype_t* block_a = ws->block_a;
+	dtype_t* block_b = ws->block_b;
+	for(uint32_t bi = 0; bi < ni; bi += blocksize) {
+		uint32_t I = MIN(blocksize, ni - bi);
+		for(uint32_t bk = 0; bk < nk; bk += blocksize) {
+			uint32_t K = MIN(blocksize, nk - bk);
+			uint32_t ld = ALIGN_UP(K, PACK_ALIGN);
 			// --- Pack A block (maintaining row-major) ---
 			for(uint32_t ii = 0; ii < I; ii++) {
-				memcpy(&block_a[ii * K], &A[(bi + ii) * nk + bk], K * sizeof(dtype_t));
+				memcpy(&block_a[ii * ld], &A[(bi + ii) * nk + bk], K * sizeof(dtype_t));
 			}
-			for(uint32_t bj = 0; bj < nj; bj += BLOCKSIZE) {
-				uint32_t J = MIN(BLOCKSIZE, nj - bj);
+			for(uint32_t bj = 0; bj < nj; bj += blocksize) {
+				uint32_t J = MIN(blocksize, nj - bj);
 				// --- Pack B block (maintain to column-major) ---
 				for(uint32_t ij = 0; ij < J; ij++) {
-					memcpy(&block_b[ij * K], &B[(bj + ij) * nk + bk], K * sizeof(dtype_t));
+					memcpy(&block_b[ij * ld], &B[(bj + ij) * nk + bk], K * sizeof(dtype_t));
 				}
 				for (uint32_t ii = 0; ii < I; ii++){
 					for(uint32_t ij = 0; ij < J; ij++) {
 						uint64_t ik = 0;
 						uint32_t c_index = (bi + ii) * nj + (bj + ij);
+						float sum = 0;
 
-						uint32_t aligned_K = K > n_avx ? K - n_avx + 1 : 0;
+#ifdef HAVE_AVX2
 						__m256 acc = _mm256_setzero_ps();
-						for(ik = 0; ik < aligned_K; ik += n_avx) {
-							__m256 a_vec = _mm256_loadu_ps(&block_a[ii * K + ik]);
-							__m256 b_vec = _mm256_loadu_ps(&block_b[ij * K + ik]);
+						for(ik = 0; ik + n_avx <= K; ik += n_avx) {
+							__m256 a_vec = _mm256_load_ps(&block_a[ii * ld + ik]);
+							__m256 b_vec = _mm256_load_ps(&block_b[ij * ld + ik]);
+							acc = _mm256_fmadd_ps(a_vec, b_vec, acc);
+						}
+						// the tail of the k loop is a masked load instead of a scalar loop
+						if(ik < K) {
+							__m256i tail = mask_avx(K - ik);
+							__m256 a_vec = _mm256_maskload_ps(&block_a[ii * ld + ik], tail);
+							__m256 b_vec = _mm256_maskload_ps(&block_b[ij * ld + ik], tail);
 							acc = _mm256_fmadd_ps(a_vec, b_vec, acc);
+							ik = K;
 						}
 
 						__m128 t1 = _mm256_castps256_ps128(acc);
@@ -216,75 +408,1754 @@ void gemm_rrc_blocked_avx(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t
 						t1 = _mm_add_ps(t1, t2); // [v0+v2, v1+v3, ?, ?]
 						t2 = _mm_shuffle_ps(t1, t1, 0x1); // [v1+v3, ?, ?, ?]
 						t1 = _mm_add_ss(t1, t2); // [v0+v1+v2+v3, ?, ?, ?]
-						float sum = _mm_cvtss_f32(t1); // cast first item of vector to f32
+						sum = _mm_cvtss_f32(t1); // cast first item of vector to f32
+#endif
 
-						for (; ik < K; ik++) sum += block_b[ij * K + ik] * block_a[ii * K + ik];
+						for (; ik < K; ik++) sum += block_b[ij * ld + ik] * block_a[ii * ld + ik];
 						C[c_index] += sum;
 					}
 				}
 			}
 		}
 	}
-	free(block_a);
-	free(block_b);
+	cpu_workspace_release(ws, &scratch);
 }
 
 
-void gemm_rrc_blocked_avx_and_omp(void* _, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+void gemm_rrc_blocked_avx_and_omp(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
 	// C is (ni, nj)
 	// A is (ni, nk)
 	// B is (nk, nj)
+	uint32_t blocksize = tuning_of(userdata)->blocksize;
+#ifdef HAVE_AVX2
 	uint8_t n_avx = 32 / sizeof(dtype_t);
+#endif
+
+	// the threads share out the block rows of C, or its block columns when there
+	// are more of those, so a short and wide C keeps them all busy too
+	uint32_t row_blocks = (ni + blocksize - 1) / blocksize;
+	uint32_t col_blocks = (nj + blocksize - 1) / blocksize;
+	int by_rows = row_blocks >= col_blocks;
 
-	#pragma omp parallel
+	GemmContext* ctx = userdata;
+	int failed = 0;
+	#pragma omp parallel num_threads(ctx ? ctx->n_threads : (uint32_t)omp_get_max_threads())
 	{
-		dtype_t* block_a = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
-		dtype_t* block_b = malloc(sizeof(dtype_t) * BLOCKSIZE * BLOCKSIZE);
+		GemmWorkspace scratch;
+		GemmWorkspace* ws = cpu_workspace_acquire(ctx, omp_get_thread_num(), blocksize * ALIGN_UP(blocksize, PACK_ALIGN), blocksize * ALIGN_UP(blocksize, PACK_ALIGN), &scratch);
+		if(!ws) {
+			#pragma omp atomic write
+			failed = 1;
+		}
+		// every thread has to agree on whether the blocks are shared out
+		#pragma omp barrier
+		dtype_t* block_a = ws ? ws->block_a : NULL;
+		dtype_t* block_b = ws ? ws->block_b : NULL;
 		#pragma omp for
-		for(uint32_t bi = 0; bi < ni; bi += BLOCKSIZE) {
-			uint32_t I = MIN(BLOCKSIZE, ni - bi);
-			for(uint32_t bk = 0; bk < nk; bk += BLOCKSIZE) {
-				uint32_t K = MIN(BLOCKSIZE, nk - bk);
-				// --- Pack A block (maintaining row-major) ---
-				for(uint32_t ii = 0; ii < I; ii++) {
-					memcpy(&block_a[ii * K], &A[(bi + ii) * nk + bk], K * sizeof(dtype_t));
-				}
-				for(uint32_t bj = 0; bj < nj; bj += BLOCKSIZE) {
-					uint32_t J = MIN(BLOCKSIZE, nj - bj);
-					// --- Pack B block (maintain to column-major) ---
-					for(uint32_t ij = 0; ij < J; ij++) {
-						memcpy(&block_b[ij * K], &B[(bj + ij) * nk + bk], K * sizeof(dtype_t));
+		for(uint32_t b = 0; b < (failed ? 0 : by_rows ? row_blocks : col_blocks); b++) {
+			uint32_t bi_begin = by_rows ? b * blocksize : 0, bi_end = by_rows ? MIN(ni, bi_begin + blocksize) : ni;
+			uint32_t bj_begin = by_rows ? 0 : b * blocksize, bj_end = by_rows ? nj : MIN(nj, bj_begin + blocksize);
+			for(uint32_t bi = bi_begin; bi < bi_end; bi += blocksize) {
+				uint32_t I = MIN(blocksize, ni - bi);
+				for(uint32_t bk = 0; bk < nk; bk += blocksize) {
+					uint32_t K = MIN(blocksize, nk - bk);
+					uint32_t ld = ALIGN_UP(K, PACK_ALIGN);
+					// --- Pack A block (maintaining row-major) ---
+					for(uint32_t ii = 0; ii < I; ii++) {
+						memcpy(&block_a[ii * ld], &A[(bi + ii) * nk + bk], K * sizeof(dtype_t));
 					}
-					for (uint32_t ii = 0; ii < I; ii++){
+					for(uint32_t bj = bj_begin; bj < bj_end; bj += blocksize) {
+						uint32_t J = MIN(blocksize, nj - bj);
+						// --- Pack B block (maintain to column-major) ---
 						for(uint32_t ij = 0; ij < J; ij++) {
-							uint64_t ik = 0;
-							uint32_t c_index = (bi + ii) * nj + (bj + ij);
+							memcpy(&block_b[ij * ld], &B[(bj + ij) * nk + bk], K * sizeof(dtype_t));
+						}
+						for (uint32_t ii = 0; ii < I; ii++){
+							for(uint32_t ij = 0; ij < J; ij++) {
+								uint64_t ik = 0;
+								uint32_t c_index = (bi + ii) * nj + (bj + ij);
+								float sum = 0;
+
+#ifdef HAVE_AVX2
+								__m256 acc = _mm256_setzero_ps();
+								for(ik = 0; ik + n_avx <= K; ik += n_avx) {
+									__m256 a_vec = _mm256_load_ps(&block_a[ii * ld + ik]);
+									__m256 b_vec = _mm256_load_ps(&block_b[ij * ld + ik]);
+									acc = _mm256_fmadd_ps(a_vec, b_vec, acc);
+								}
+								// the tail of the k loop is a masked load instead of a scalar loop
+								if(ik < K) {
+									__m256i tail = mask_avx(K - ik);
+									__m256 a_vec = _mm256_maskload_ps(&block_a[ii * ld + ik], tail);
+									__m256 b_vec = _mm256_maskload_ps(&block_b[ij * ld + ik], tail);
+									acc = _mm256_fmadd_ps(a_vec, b_vec, acc);
+									ik = K;
+								}
+
+								__m128 t1 = _mm256_castps256_ps128(acc);
+								__m128 t2 = _mm256_extractf128_ps(acc, 1);
+								t1 = _mm_add_ps(t1, t2); // [r0+r4 (v0), r1+r5 (v1), r2+r6 (v2), r3+r7 (v3)]
+								t2 = _mm_movehl_ps(t1, t1); // [v2, v3, ?, ?]
+								t1 = _mm_add_ps(t1, t2); // [v0+v2, v1+v3, ?, ?]
+								t2 = _mm_shuffle_ps(t1, t1, 0x1); // [v1+v3, ?, ?, ?]
+								t1 = _mm_add_ss(t1, t2); // [v0+v1+v2+v3, ?, ?, ?]
+								sum = _mm_cvtss_f32(t1); // cast first item of vector to f32
+#endif
 
-							uint32_t aligned_K = K > n_avx ? K - n_avx + 1 : 0;
-							__m256 acc = _mm256_setzero_ps();
-							for(ik = 0; ik < aligned_K; ik += n_avx) {
-								__m256 a_vec = _mm256_loadu_ps(&block_a[ii * K + ik]);
-								__m256 b_vec = _mm256_loadu_ps(&block_b[ij * K + ik]);
-								acc = _mm256_fmadd_ps(a_vec, b_vec, acc);
+								for (; ik < K; ik++) sum += block_b[ij * ld + ik] * block_a[ii * ld + ik];
+								C[c_index] += sum;
 							}
+						}
+					}
+				}
+			}
+		}
+		if(ws) {
+			cpu_workspace_release(ws, &scratch);
+		}
+	}
+	if(failed) {
+		gemm_rrc_blocked_without_packing(userdata, C, A, B, ni, nj, nk);
+	}
+}
+
+// largest register tile of the micro-kernels below
+#define MR_MAX 14
+#define NR_MAX 32
+
+// the BLIS driver shared with the other types (see cpu_gemm_typed.c), run by
+// the hand-tuned micro-kernels below
+#define GEMM_TYPE GEMM_TYPE_F32
+#include "cpu_gemm_typed.h"
+#undef GEMM_TYPE
+
+// k loop of the micro-kernels, with step repeated unroll times (a constant in
+// every instantiation below) and a plain loop for the remainder
+#define K_LOOP(unroll, step) \
+	uint32_t ik = 0; \
+	for(; ik + (unroll) <= k; ik += (unroll)) { \
+		_Pragma("GCC unroll 4") \
+		for(uint32_t iu = 0; iu < (unroll); iu++) { \
+			step \
+		} \
+	} \
+	for(; ik < k; ik++) { \
+		step \
+	}
+
+// the micro-kernels are always inlined into one function per unroll factor
+#define DEFINE_UNROLLED(name) \
+	static void name##_u1(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n) { \
+		name(k, a, b, C, ldc, m, n, 1); \
+	} \
+	static void name##_u2(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n) { \
+		name(k, a, b, C, ldc, m, n, 2); \
+	} \
+	static void name##_u4(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n) { \
+		name(k, a, b, C, ldc, m, n, 4); \
+	}
+#define UNROLLED(name) { name##_u1, name##_u2, name##_u4 }
+
+#if !defined(HAVE_SSE2)
+#define MR_GENERIC 4
+#define NR_GENERIC 8
+
+// plain C micro-kernel for the scalar build, the tile is small enough for
+// the compiler to keep it in registers
+#define STEP_GENERIC \
+	for(uint32_t ii = 0; ii < MR_GENERIC; ii++) { \
+		for(uint32_t ij = 0; ij < NR_GENERIC; ij++) { \
+			acc[ii][ij] += a[ii] * b[ij]; \
+		} \
+	} \
+	a += MR_GENERIC; \
+	b += NR_GENERIC;
+
+static inline __attribute__((always_inline)) void micro_kernel_4x8_generic(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n, uint32_t unroll) {
+	dtype_t acc[MR_GENERIC][NR_GENERIC] = {{0}};
+	K_LOOP(unroll, STEP_GENERIC)
+	for(uint32_t ii = 0; ii < m; ii++) {
+		for(uint32_t ij = 0; ij < n; ij++) {
+			C[ii * ldc + ij] += acc[ii][ij];
+		}
+	}
+}
+
+DEFINE_UNROLLED(micro_kernel_4x8_generic)
+
+static BlisConfig blis_generic = { UNROLLED(micro_kernel_4x8_generic), UNROLLED(micro_kernel_4x8_generic), MR_GENERIC, NR_GENERIC, NR_GENERIC, -1 };
+#endif
+
+#if defined(HAVE_SSE2) && !defined(HAVE_AVX2)
+#define MR_SSE2 6
+#define NR_SSE2 8
+
+#define FMA_ROW_SSE2(r) \
+	a_scalar = _mm_set1_ps(a[r]); \
+	c##r##0 = _mm_add_ps(_mm_mul_ps(a_scalar, b0), c##r##0); \
+	c##r##1 = _mm_add_ps(_mm_mul_ps(a_scalar, b1), c##r##1);
+
+#define UPDATE_ROW_SSE2(r) \
+	_mm_storeu_ps(&c[r * ldt], _mm_add_ps(_mm_loadu_ps(&c[r * ldt]), c##r##0)); \
+	_mm_storeu_ps(&c[r * ldt + 4], _mm_add_ps(_mm_loadu_ps(&c[r * ldt + 4]), c##r##1));
+
+#define STEP_SSE2 { \
+		__m128 b0 = _mm_load_ps(b); \
+		__m128 b1 = _mm_load_ps(b + 4); \
+		__m128 a_scalar; \
+		FMA_ROW_SSE2(0) FMA_ROW_SSE2(1) FMA_ROW_SSE2(2) \
+		FMA_ROW_SSE2(3) FMA_ROW_SSE2(4) FMA_ROW_SSE2(5) \
+		a += MR_SSE2; \
+		b += NR_SSE2; \
+	}
+
+// C[0:m, 0:n] += a_panel * b_panel with a 6x8 tile in 12 xmm registers (SSE2
+// has no FMA, so every step is a multiply and an add)
+static inline __attribute__((always_inline)) void micro_kernel_6x8_sse2(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n, uint32_t unroll) {
+	__m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+	__m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+	__m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+	__m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+	__m128 c40 = _mm_setzero_ps(), c41 = _mm_setzero_ps();
+	__m128 c50 = _mm_setzero_ps(), c51 = _mm_setzero_ps();
+	K_LOOP(unroll, STEP_SSE2)
 
-							__m128 t1 = _mm256_castps256_ps128(acc);
-							__m128 t2 = _mm256_extractf128_ps(acc, 1);
-							t1 = _mm_add_ps(t1, t2); // [r0+r4 (v0), r1+r5 (v1), r2+r6 (v2), r3+r7 (v3)]
-							t2 = _mm_movehl_ps(t1, t1); // [v2, v3, ?, ?]
-							t1 = _mm_add_ps(t1, t2); // [v0+v2, v1+v3, ?, ?]
-							t2 = _mm_shuffle_ps(t1, t1, 0x1); // [v1+v3, ?, ?, ?]
-							t1 = _mm_add_ss(t1, t2); // [v0+v1+v2+v3, ?, ?, ?]
-							float sum = _mm_cvtss_f32(t1); // cast first item of vector to f32
-
-							for (; ik < K; ik++) sum += block_b[ij * K + ik] * block_a[ii * K + ik];
-							C[c_index] += sum;
+	// full tiles go straight to C, edge tiles go through a scratch tile
+	dtype_t tile[MR_SSE2 * NR_SSE2];
+	dtype_t* c = C;
+	uint32_t ldt = ldc;
+	if(m != MR_SSE2 || n != NR_SSE2) {
+		c = tile;
+		ldt = NR_SSE2;
+		memset(tile, 0x00, sizeof(tile));
+	}
+	UPDATE_ROW_SSE2(0) UPDATE_ROW_SSE2(1) UPDATE_ROW_SSE2(2)
+	UPDATE_ROW_SSE2(3) UPDATE_ROW_SSE2(4) UPDATE_ROW_SSE2(5)
+	if(c == tile) {
+		for(uint32_t ii = 0; ii < m; ii++) {
+			for(uint32_t ij = 0; ij < n; ij++) {
+				C[ii * ldc + ij] += tile[ii * NR_SSE2 + ij];
+			}
+		}
+	}
+}
+
+DEFINE_UNROLLED(micro_kernel_6x8_sse2)
+
+static BlisConfig blis_sse2 = { UNROLLED(micro_kernel_6x8_sse2), UNROLLED(micro_kernel_6x8_sse2), MR_SSE2, NR_SSE2, NR_SSE2, -1 };
+#endif
+
+#ifdef HAVE_AVX2
+#define MR_AVX 6
+#define NR_AVX 16
+
+// C[0:m, 0:n] += a_panel * b_panel, with the whole 6x16 tile of C living in
+// 12 ymm registers for the duration of the k loop. The packed micro-panels
+// start on GEMM_ALIGNMENT boundaries (cpu_alloc'd workspaces, offsets that are
+// multiples of NR), so the rows of B are read with aligned loads
+#define FMA_ROW_AVX(r) \
+	a_scalar = _mm256_broadcast_ss(a + r); \
+	c##r##0 = _mm256_fmadd_ps(a_scalar, b0, c##r##0); \
+	c##r##1 = _mm256_fmadd_ps(a_scalar, b1, c##r##1);
+
+#define STEP_AVX { \
+		__m256 b0 = _mm256_load_ps(b); \
+		__m256 b1 = _mm256_load_ps(b + 8); \
+		__m256 a_scalar; \
+		FMA_ROW_AVX(0) FMA_ROW_AVX(1) FMA_ROW_AVX(2) \
+		FMA_ROW_AVX(3) FMA_ROW_AVX(4) FMA_ROW_AVX(5) \
+		a += MR_AVX; \
+		b += NR_AVX; \
+	}
+
+#define FMA_HALF_ROW_AVX(r) \
+	a_scalar = _mm256_broadcast_ss(a + r); \
+	c##r##0 = _mm256_fmadd_ps(a_scalar, b0, c##r##0);
+
+#define STEP_AVX_EDGE { \
+		__m256 b0 = _mm256_load_ps(b); \
+		__m256 a_scalar; \
+		FMA_HALF_ROW_AVX(0) FMA_HALF_ROW_AVX(1) FMA_HALF_ROW_AVX(2) \
+		FMA_HALF_ROW_AVX(3) FMA_HALF_ROW_AVX(4) FMA_HALF_ROW_AVX(5) \
+		a += MR_AVX; \
+		b += NR_AVX; \
+	}
+
+#define UPDATE_ROW_AVX(r, load, store) \
+	store(&C[r * ldc], _mm256_add_ps(load(&C[r * ldc]), c##r##0)); \
+	store(&C[r * ldc + 8], _mm256_add_ps(load(&C[r * ldc + 8]), c##r##1));
+
+#define MASKED_UPDATE_HALF_ROW_AVX(r) \
+	if(r < m) { \
+		_mm256_maskstore_ps(&C[r * ldc], mask0, _mm256_add_ps(_mm256_maskload_ps(&C[r * ldc], mask0), c##r##0)); \
+	}
+
+#define MASKED_UPDATE_ROW_AVX(r) \
+	MASKED_UPDATE_HALF_ROW_AVX(r) \
+	if(r < m) { \
+		_mm256_maskstore_ps(&C[r * ldc + 8], mask1, _mm256_add_ps(_mm256_maskload_ps(&C[r * ldc + 8], mask1), c##r##1)); \
+	}
+
+static inline __attribute__((always_inline)) void micro_kernel_6x16_avx(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n, uint32_t unroll) {
+	__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+	__m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+	__m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+	__m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+	__m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+	__m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+	K_LOOP(unroll, STEP_AVX)
+
+	// full tiles go straight to C (with aligned accesses when C and its
+	// leading dimension allow them), edge tiles through masked loads and stores
+	if(m == MR_AVX && n == NR_AVX && !(((uintptr_t)C | ldc * sizeof(dtype_t)) % sizeof(__m256))) {
+		UPDATE_ROW_AVX(0, _mm256_load_ps, _mm256_store_ps) UPDATE_ROW_AVX(1, _mm256_load_ps, _mm256_store_ps)
+		UPDATE_ROW_AVX(2, _mm256_load_ps, _mm256_store_ps) UPDATE_ROW_AVX(3, _mm256_load_ps, _mm256_store_ps)
+		UPDATE_ROW_AVX(4, _mm256_load_ps, _mm256_store_ps) UPDATE_ROW_AVX(5, _mm256_load_ps, _mm256_store_ps)
+	} else if(m == MR_AVX && n == NR_AVX) {
+		UPDATE_ROW_AVX(0, _mm256_loadu_ps, _mm256_storeu_ps) UPDATE_ROW_AVX(1, _mm256_loadu_ps, _mm256_storeu_ps)
+		UPDATE_ROW_AVX(2, _mm256_loadu_ps, _mm256_storeu_ps) UPDATE_ROW_AVX(3, _mm256_loadu_ps, _mm256_storeu_ps)
+		UPDATE_ROW_AVX(4, _mm256_loadu_ps, _mm256_storeu_ps) UPDATE_ROW_AVX(5, _mm256_loadu_ps, _mm256_storeu_ps)
+	} else {
+		__m256i mask0 = mask_avx(n);
+		__m256i mask1 = mask_avx(n > 8 ? n - 8 : 0);
+		MASKED_UPDATE_ROW_AVX(0) MASKED_UPDATE_ROW_AVX(1) MASKED_UPDATE_ROW_AVX(2)
+		MASKED_UPDATE_ROW_AVX(3) MASKED_UPDATE_ROW_AVX(4) MASKED_UPDATE_ROW_AVX(5)
+	}
+}
+
+// right edge of the 6x16 kernel: tiles at most 8 columns wide only need the
+// first ymm of every row of the (zero-padded, NR_AVX wide) micro-panel of B
+static inline __attribute__((always_inline)) void micro_kernel_6x16_avx_edge(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n, uint32_t unroll) {
+	__m256 c00 = _mm256_setzero_ps(), c10 = _mm256_setzero_ps(), c20 = _mm256_setzero_ps();
+	__m256 c30 = _mm256_setzero_ps(), c40 = _mm256_setzero_ps(), c50 = _mm256_setzero_ps();
+	K_LOOP(unroll, STEP_AVX_EDGE)
+
+	__m256i mask0 = mask_avx(n);
+	MASKED_UPDATE_HALF_ROW_AVX(0) MASKED_UPDATE_HALF_ROW_AVX(1) MASKED_UPDATE_HALF_ROW_AVX(2)
+	MASKED_UPDATE_HALF_ROW_AVX(3) MASKED_UPDATE_HALF_ROW_AVX(4) MASKED_UPDATE_HALF_ROW_AVX(5)
+}
+
+DEFINE_UNROLLED(micro_kernel_6x16_avx)
+DEFINE_UNROLLED(micro_kernel_6x16_avx_edge)
+
+static BlisConfig blis_avx = { UNROLLED(micro_kernel_6x16_avx), UNROLLED(micro_kernel_6x16_avx_edge), MR_AVX, NR_AVX, NR_AVX / 2, -1 };
+#endif
+
+#ifdef HAVE_AVX512
+// AVX-512 has 32 zmm registers, so the register tile grows to 14 x 32
+// (28 accumulators)
+#define MR_AVX512 14
+#define NR_AVX512 32
+
+#define FMA_ROW_AVX512(r) \
+	a_scalar = _mm512_set1_ps(a[r]); \
+	c##r##0 = _mm512_fmadd_ps(a_scalar, b0, c##r##0); \
+	c##r##1 = _mm512_fmadd_ps(a_scalar, b1, c##r##1);
+
+#define UPDATE_ROW_AVX512(r) \
+	if(r < m) { \
+		_mm512_mask_storeu_ps(&C[r * ldc], mask0, _mm512_add_ps(_mm512_maskz_loadu_ps(mask0, &C[r * ldc]), c##r##0)); \
+		_mm512_mask_storeu_ps(&C[r * ldc + 16], mask1, _mm512_add_ps(_mm512_maskz_loadu_ps(mask1, &C[r * ldc + 16]), c##r##1)); \
+	}
+
+#define STEP_AVX512 { \
+		__m512 b0 = _mm512_load_ps(b); \
+		__m512 b1 = _mm512_load_ps(b + 16); \
+		__m512 a_scalar; \
+		FMA_ROW_AVX512(0) FMA_ROW_AVX512(1) FMA_ROW_AVX512(2) FMA_ROW_AVX512(3) \
+		FMA_ROW_AVX512(4) FMA_ROW_AVX512(5) FMA_ROW_AVX512(6) FMA_ROW_AVX512(7) \
+		FMA_ROW_AVX512(8) FMA_ROW_AVX512(9) FMA_ROW_AVX512(10) FMA_ROW_AVX512(11) \
+		FMA_ROW_AVX512(12) FMA_ROW_AVX512(13) \
+		a += MR_AVX512; \
+		b += NR_AVX512; \
+	}
+
+#define FMA_HALF_ROW_AVX512(r) \
+	a_scalar = _mm512_set1_ps(a[r]); \
+	c##r##0 = _mm512_fmadd_ps(a_scalar, b0, c##r##0);
+
+#define STEP_AVX512_EDGE { \
+		__m512 b0 = _mm512_load_ps(b); \
+		__m512 a_scalar; \
+		FMA_HALF_ROW_AVX512(0) FMA_HALF_ROW_AVX512(1) FMA_HALF_ROW_AVX512(2) FMA_HALF_ROW_AVX512(3) \
+		FMA_HALF_ROW_AVX512(4) FMA_HALF_ROW_AVX512(5) FMA_HALF_ROW_AVX512(6) FMA_HALF_ROW_AVX512(7) \
+		FMA_HALF_ROW_AVX512(8) FMA_HALF_ROW_AVX512(9) FMA_HALF_ROW_AVX512(10) FMA_HALF_ROW_AVX512(11) \
+		FMA_HALF_ROW_AVX512(12) FMA_HALF_ROW_AVX512(13) \
+		a += MR_AVX512; \
+		b += NR_AVX512; \
+	}
+
+#define UPDATE_HALF_ROW_AVX512(r) \
+	if(r < m) { \
+		_mm512_mask_storeu_ps(&C[r * ldc], mask0, _mm512_add_ps(_mm512_maskz_loadu_ps(mask0, &C[r * ldc]), c##r##0)); \
+	}
+
+// C[0:m, 0:n] += a_panel * b_panel, with the 14x32 tile of C living in 28 zmm
+// registers. Partial tiles are written back with masked loads and stores
+static inline __attribute__((always_inline)) void micro_kernel_14x32_avx512(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n, uint32_t unroll) {
+	__m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+	__m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+	__m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+	__m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+	__m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+	__m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+	__m512 c60 = _mm512_setzero_ps(), c61 = _mm512_setzero_ps();
+	__m512 c70 = _mm512_setzero_ps(), c71 = _mm512_setzero_ps();
+	__m512 c80 = _mm512_setzero_ps(), c81 = _mm512_setzero_ps();
+	__m512 c90 = _mm512_setzero_ps(), c91 = _mm512_setzero_ps();
+	__m512 c100 = _mm512_setzero_ps(), c101 = _mm512_setzero_ps();
+	__m512 c110 = _mm512_setzero_ps(), c111 = _mm512_setzero_ps();
+	__m512 c120 = _mm512_setzero_ps(), c121 = _mm512_setzero_ps();
+	__m512 c130 = _mm512_setzero_ps(), c131 = _mm512_setzero_ps();
+	K_LOOP(unroll, STEP_AVX512)
+
+	__mmask16 mask0 = n >= 16 ? 0xFFFF : (__mmask16)((1u << n) - 1);
+	__mmask16 mask1 = n >= 32 ? 0xFFFF : n > 16 ? (__mmask16)((1u << (n - 16)) - 1) : 0;
+	UPDATE_ROW_AVX512(0) UPDATE_ROW_AVX512(1) UPDATE_ROW_AVX512(2) UPDATE_ROW_AVX512(3)
+	UPDATE_ROW_AVX512(4) UPDATE_ROW_AVX512(5) UPDATE_ROW_AVX512(6) UPDATE_ROW_AVX512(7)
+	UPDATE_ROW_AVX512(8) UPDATE_ROW_AVX512(9) UPDATE_ROW_AVX512(10) UPDATE_ROW_AVX512(11)
+	UPDATE_ROW_AVX512(12) UPDATE_ROW_AVX512(13)
+}
+
+// right edge of the 14x32 kernel, for tiles at most 16 columns wide
+static inline __attribute__((always_inline)) void micro_kernel_14x32_avx512_edge(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n, uint32_t unroll) {
+	__m512 c00 = _mm512_setzero_ps(), c10 = _mm512_setzero_ps(), c20 = _mm512_setzero_ps();
+	__m512 c30 = _mm512_setzero_ps(), c40 = _mm512_setzero_ps(), c50 = _mm512_setzero_ps();
+	__m512 c60 = _mm512_setzero_ps(), c70 = _mm512_setzero_ps(), c80 = _mm512_setzero_ps();
+	__m512 c90 = _mm512_setzero_ps(), c100 = _mm512_setzero_ps(), c110 = _mm512_setzero_ps();
+	__m512 c120 = _mm512_setzero_ps(), c130 = _mm512_setzero_ps();
+	K_LOOP(unroll, STEP_AVX512_EDGE)
+
+	__mmask16 mask0 = n >= 16 ? 0xFFFF : (__mmask16)((1u << n) - 1);
+	UPDATE_HALF_ROW_AVX512(0) UPDATE_HALF_ROW_AVX512(1) UPDATE_HALF_ROW_AVX512(2) UPDATE_HALF_ROW_AVX512(3)
+	UPDATE_HALF_ROW_AVX512(4) UPDATE_HALF_ROW_AVX512(5) UPDATE_HALF_ROW_AVX512(6) UPDATE_HALF_ROW_AVX512(7)
+	UPDATE_HALF_ROW_AVX512(8) UPDATE_HALF_ROW_AVX512(9) UPDATE_HALF_ROW_AVX512(10) UPDATE_HALF_ROW_AVX512(11)
+	UPDATE_HALF_ROW_AVX512(12) UPDATE_HALF_ROW_AVX512(13)
+}
+
+DEFINE_UNROLLED(micro_kernel_14x32_avx512)
+DEFINE_UNROLLED(micro_kernel_14x32_avx512_edge)
+
+static BlisConfig blis_avx512 = { UNROLLED(micro_kernel_14x32_avx512), UNROLLED(micro_kernel_14x32_avx512_edge), MR_AVX512, NR_AVX512, NR_AVX512 / 2, -1 };
+#endif
+
+// widest micro-kernel this build of the file has
+#if defined(HAVE_AVX512)
+#define BLIS_BEST blis_avx512
+#elif defined(HAVE_AVX2)
+#define BLIS_BEST blis_avx
+#elif defined(HAVE_SSE2)
+#define BLIS_BEST blis_sse2
+#else
+#define BLIS_BEST blis_generic
+#endif
+
+// the reproducible mode fixes the KC blocking and the split-K slices (as many as
+// for this many threads) instead of taking them from the tuning and the context
+#define REPRO_KC 256
+#define REPRO_SPLITS 16
+
+// micro-kernels whose arithmetic is the same on every ISA: one fused
+// multiply-add per k into an accumulator per element of C that starts at zero,
+// added to C once at the end. The FMA builds already do exactly that, the
+// others do it with fmaf (slow where FMA isn't in hardware)
+#ifdef HAVE_AVX2
+#define BLIS_REPRODUCIBLE BLIS_BEST
+#else
+#define MR_FMAF 4
+#define NR_FMAF 8
+
+static void micro_kernel_4x8_fmaf(uint32_t k, dtype_t* a, dtype_t* b, dtype_t* C, uint32_t ldc, uint32_t m, uint32_t n) {
+	dtype_t acc[MR_FMAF][NR_FMAF] = {{0}};
+	for(uint32_t ik = 0; ik < k; ik++, a += MR_FMAF, b += NR_FMAF) {
+		for(uint32_t ii = 0; ii < MR_FMAF; ii++) {
+			for(uint32_t ij = 0; ij < NR_FMAF; ij++) {
+				acc[ii][ij] = fmaf(a[ii], b[ij], acc[ii][ij]);
+			}
+		}
+	}
+	for(uint32_t ii = 0; ii < m; ii++) {
+		for(uint32_t ij = 0; ij < n; ij++) {
+			C[ii * ldc + ij] += acc[ii][ij];
+		}
+	}
+}
+
+#define FMAF_KERNELS { micro_kernel_4x8_fmaf, micro_kernel_4x8_fmaf, micro_kernel_4x8_fmaf }
+static BlisConfig blis_fmaf = { FMAF_KERNELS, FMAF_KERNELS, MR_FMAF, NR_FMAF, NR_FMAF, -1 };
+#define BLIS_REPRODUCIBLE blis_fmaf
+#endif
+
+// the names have to match the table of src/cpu/cpu_tune.c
+__attribute__((constructor)) static void init_tuning(void) {
+#if !defined(HAVE_SSE2)
+	blis_generic.tuning = cpu_tuning_blis("4x8_generic");
+#endif
+#if defined(HAVE_SSE2) && !defined(HAVE_AVX2)
+	blis_sse2.tuning = cpu_tuning_blis("6x8_sse2");
+#endif
+#ifdef HAVE_AVX2
+	blis_avx.tuning = cpu_tuning_blis("6x16_avx");
+#endif
+#ifdef HAVE_AVX512
+	blis_avx512.tuning = cpu_tuning_blis("14x32_avx512");
+#endif
+#ifndef HAVE_AVX2
+	// MC and NC only, the reproducible mode sets its own KC
+	blis_fmaf.tuning = BLIS_BEST.tuning;
+#endif
+}
+
+// every KC x NC block of a (nk, nj) B with strides rs/cs, packed the way
+// gemm_rrc_blis packs them one at a time
+static void pack_b_blocks(GemmPackedB* packed, dtype_t* B, uint32_t rs, uint32_t cs) {
+	uint32_t nk = packed->nk, nj = packed->nj, kc = packed->kc, nc = packed->nc;
+	for(uint32_t jc = 0; jc < nj; jc += nc) {
+		uint32_t J = MIN(nc, nj - jc);
+		for(uint32_t pc = 0; pc < nk; pc += kc) {
+			uint32_t K = MIN(kc, nk - pc);
+			pack_b_panels(cpu_packed_b_block(packed, pc, jc, J), &B[pc * rs + jc * cs], rs, cs, K, J, packed->nr);
+		}
+	}
+}
+
+// the dense case of gemm_blis_strided: ldc, lda and ldb are the strides between
+// the rows of C and A and the columns of B
+static void gemm_rrc_blis_strided(const BlisConfig* cfg, GemmContext* ctx, const BlisTuning* t, uint32_t thread, dtype_t* C, dtype_t* E, uint32_t ldc, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, uint32_t ni, uint32_t nj, uint32_t nk) {
+	gemm_blis_strided(cfg, ctx, t, thread, C, E, ldc, A, lda, 1, B, 1, ldb, 1, ni, nj, nk);
+}
+
+// whole column major (nk, n) operand packed with the given blocking, from the
+// pack cache of the context, or packed into it when it fits the budget. NULL
+// when it doesn't fit (or there is no memory for it): the operand is then
+// packed block by block into the workspaces as without the cache
+static GemmPackedB* cached_pack(GemmContext* ctx, dtype_t* src, uint32_t nk, uint32_t n, uint32_t kc, uint32_t nc, uint32_t nr) {
+	PackKey key = { .src = src, .nk = nk, .n = n, .layout = GEMM_COL_MAJOR, .epoch = ctx->epoch, .kc = kc, .nc = nc, .nr = nr };
+	GemmPackedB* packed = cpu_pack_cache_find(&ctx->pack_cache, &key);
+	if(packed) {
+		return packed;
+	}
+	if(cpu_pack_cache_reserve(&ctx->pack_cache, cpu_packed_b_size(nk, n, nc, nr)) || !(packed = cpu_packed_b_create(nk, n, kc, nc, nr))) {
+		return NULL;
+	}
+	pack_b_blocks(packed, src, 1, nk);
+	if(cpu_pack_cache_insert(&ctx->pack_cache, &key, packed)) {
+		gemm_packed_b_free(packed);
+		return NULL;
+	}
+	return packed;
+}
+
+// the micro-panels of a whole packed operand from line x on (a multiple of its
+// NR inside its NC block), in the KC block at pc
+static dtype_t* packed_panels(const GemmPackedB* packed, uint32_t pc, uint32_t x, uint32_t K) {
+	uint32_t xc = x / packed->nc * packed->nc;
+	return cpu_packed_b_block(packed, pc, xc, MIN(packed->nc, packed->nj - xc)) + (size_t)(x - xc) * K;
+}
+
+// rows [i0, i0 + ni) and columns [j0, j0 + nj) of C += A B (dense rrc, ldc the
+// row stride of C), with A and B read from whole packed operands when they are
+// given (blocked by the MC, KC and NC of t) or else packed block by block into
+// the workspace of the thread. i0 and j0 are multiples of MR and NR, so they
+// start micro-panels: MC and NC are multiples of those (see sanitize_blis)
+static void gemm_rrc_blis_packed(const BlisConfig* cfg, GemmContext* ctx, const BlisTuning* t, uint32_t thread, dtype_t* C, uint32_t ldc, dtype_t* A, dtype_t* B, const GemmPackedB* packed_a, const GemmPackedB* packed_b, uint32_t i0, uint32_t j0, uint32_t ni, uint32_t nj, uint32_t nk) {
+	uint32_t mc = t->mc, kc = t->kc, nc = t->nc;
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(ctx, thread, packed_a ? 0 : mc * kc, packed_b ? 0 : kc * nc, &scratch);
+	if(!ws) {
+		gemm_unpacked(&C[(size_t)i0 * ldc + j0], ldc, &A[(size_t)i0 * nk], nk, 1, &B[(size_t)j0 * nk], 1, nk, 1, ni, nj, nk);
+		return;
+	}
+	// the blocks follow the NC and MC grid of the packed operands
+	for(uint32_t jc = j0, J; jc < j0 + nj; jc += J) {
+		J = MIN(nc - jc % nc, j0 + nj - jc);
+		for(uint32_t pc = 0; pc < nk; pc += kc) {
+			uint32_t K = MIN(kc, nk - pc);
+			dtype_t* block_b = packed_b ? packed_panels(packed_b, pc, jc, K) : ws->block_b;
+			if(!packed_b) {
+				// --- Pack B block into KC x NR micro-panels ---
+				pack_b_panels(block_b, &B[(size_t)jc * nk + pc], 1, nk, K, J, cfg->nr);
+			}
+			for(uint32_t ic = i0, I; ic < i0 + ni; ic += I) {
+				I = MIN(mc - ic % mc, i0 + ni - ic);
+				dtype_t* block_a = packed_a ? packed_panels(packed_a, pc, ic, K) : ws->block_a;
+				if(!packed_a) {
+					// --- Pack A block into MR x KC micro-panels ---
+					pack_a_panels(block_a, &A[(size_t)ic * nk + pc], nk, 1, I, K, cfg->mr);
+				}
+				blis_macro_kernel(cfg, t, block_a, block_b, &C[(size_t)ic * ldc + jc], NULL, ldc, I, K, J);
+			}
+		}
+	}
+	cpu_workspace_release(ws, &scratch);
+}
+
+// C += A B with A and B from the pack cache of the context, looked up or packed
+// once before the threads start and then read by all of them, one strip of C
+// each as in gemm_blis_strips
+static void gemm_rrc_blis_cached(const BlisConfig* cfg, GemmContext* ctx, const BlisTuning* t, uint32_t n_threads, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	if(!ni || !nj) {
+		return;
+	}
+	cpu_pack_cache_begin(&ctx->pack_cache);
+	// A is packed as the column major B of A^T, MR x KC micro-panels are the
+	// KC x MR micro-panels of A^T
+	GemmPackedB* packed_a = cached_pack(ctx, A, nk, ni, t->kc, t->mc, cfg->mr);
+	GemmPackedB* packed_b = cached_pack(ctx, B, nk, nj, t->kc, t->nc, cfg->nr);
+	GemmStrips strips = cpu_strips(ni, nj, cfg->mr, cfg->nr, n_threads);
+	#pragma omp parallel num_threads(strips.count)
+	{
+		uint32_t thread = omp_get_thread_num(), size;
+		uint32_t begin = cpu_strip(&strips, thread, &size);
+		if(size && strips.by_rows) {
+			gemm_rrc_blis_packed(cfg, ctx, t, thread, C, nj, A, B, packed_a, packed_b, begin, 0, size, nj, nk);
+		} else if(size) {
+			gemm_rrc_blis_packed(cfg, ctx, t, thread, C, nj, A, B, packed_a, packed_b, 0, begin, ni, size, nk);
+		}
+	}
+}
+
+#if defined(HAVE_AVX512)
+#define JIT_ISA JIT_AVX512
+#elif defined(HAVE_AVX2)
+#define JIT_ISA JIT_AVX2
+#endif
+
+#ifdef JIT_ISA
+// gemm_rrc_blis_strided with the micro-kernel generated for the K of every
+// block (cfg's own kernel when it can't be), which the generated code falls
+// back to for the edge tiles
+static void gemm_rrc_blis_jit_strided(const BlisConfig* cfg, GemmContext* ctx, dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, uint32_t ni, uint32_t nj, uint32_t nk) {
+	const BlisTuning* t = &tuning_of(ctx)->blis[cfg->tuning];
+	uint32_t mc = t->mc, kc = t->kc, nc = t->nc;
+	MicroKernel fallback = cfg->kernel[UNROLL_INDEX(t->unroll)];
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(ctx, 0, mc * kc, kc * nc, &scratch);
+	if(!ws) {
+		gemm_unpacked(C, ldc, A, lda, 1, B, 1, ldb, 1, ni, nj, nk);
+		return;
+	}
+	for(uint32_t jc = 0; jc < nj; jc += nc) {
+		uint32_t J = MIN(nc, nj - jc);
+		for(uint32_t pc = 0; pc < nk; pc += kc) {
+			uint32_t K = MIN(kc, nk - pc);
+			JitSpec spec = { JIT_ISA, cfg->mr, cfg->nr, K, GEMM_ROW_MAJOR, JIT_ACCUMULATE, fallback };
+			JitKernel jit = cpu_jit_kernel(&spec);
+			BlisConfig with_jit = *cfg;
+			for(uint32_t u = 0; jit && u < 3; u++) with_jit.kernel[u] = jit;
+			// --- Pack B block into KC x NR micro-panels ---
+			pack_b_panels(ws->block_b, &B[pc + jc * ldb], 1, ldb, K, J, cfg->nr);
+			blis_block(&with_jit, t, ws->block_a, ws->block_b, C, NULL, ldc, A, lda, 1, ni, pc, jc, K, J);
+		}
+	}
+	cpu_workspace_release(ws, &scratch);
+}
+#endif
+
+static void gemm_rrc_blis(const BlisConfig* cfg, GemmContext* ctx, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	// C is (ni, nj) row major
+	// A is (ni, nk) row major
+	// B is (nk, nj) column major
+	if(ctx && ctx->pack_cache.budget) {
+		gemm_rrc_blis_cached(cfg, ctx, &tuning_of(ctx)->blis[cfg->tuning], 1, C, A, B, ni, nj, nk);
+		return;
+	}
+	gemm_rrc_blis_strided(cfg, ctx, &tuning_of(ctx)->blis[cfg->tuning], 0, C, NULL, nj, A, nk, B, nk, ni, nj, nk);
+}
+
+// the ISA-named variants fall back to the widest available micro-kernel in
+// builds that lack their instruction set
+void gemm_rrc_blis_avx(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+#ifdef HAVE_AVX2
+	gemm_rrc_blis(&blis_avx, userdata, C, A, B, ni, nj, nk);
+#else
+	gemm_rrc_blis(&BLIS_BEST, userdata, C, A, B, ni, nj, nk);
+#endif
+}
+
+void gemm_rrc_blocked_avx512(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	// C is (ni, nj)
+	// A is (ni, nk)
+	// B is (nk, nj)
+#ifndef HAVE_AVX512
+	gemm_rrc_blocked_avx(userdata, C, A, B, ni, nj, nk);
+#else
+	uint32_t blocksize = tuning_of(userdata)->blocksize;
+	uint8_t n_avx = 64 / sizeof(dtype_t);
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(userdata, 0, blocksize * ALIGN_UP(blocksize, PACK_ALIGN), blocksize * ALIGN_UP(blocksize, PACK_ALIGN), &scratch);
+	if(!ws) {
+		// out of memory: the same blocking without the packed copies
+		gemm_rrc_blocked_without_packing(userdata, C, A, B, ni, nj, nk);
+		return;
+	}
+	dtype_t* block_a = ws->block_a;
+	dtype_t* block_b = ws->block_b;
+	for(uint32_t bi = 0; bi < ni; bi += blocksize) {
+		uint32_t I = MIN(blocksize, ni - bi);
+		for(uint32_t bk = 0; bk < nk; bk += blocksize) {
+			uint32_t K = MIN(blocksize, nk - bk);
+			uint32_t ld = ALIGN_UP(K, PACK_ALIGN);
+			// --- Pack A block (maintaining row-major) ---
+			for(uint32_t ii = 0; ii < I; ii++) {
+				memcpy(&block_a[ii * ld], &A[(bi + ii) * nk + bk], K * sizeof(dtype_t));
+			}
+			// the tail of the k loop is done with a masked load instead of a scalar loop
+			uint32_t aligned_K = K - K % n_avx;
+			__mmask16 tail = (__mmask16)((1u << (K % n_avx)) - 1);
+			for(uint32_t bj = 0; bj < nj; bj += blocksize) {
+				uint32_t J = MIN(blocksize, nj - bj);
+				// --- Pack B block (maintain to column-major) ---
+				for(uint32_t ij = 0; ij < J; ij++) {
+					memcpy(&block_b[ij * ld], &B[(bj + ij) * nk + bk], K * sizeof(dtype_t));
+				}
+				for (uint32_t ii = 0; ii < I; ii++){
+					for(uint32_t ij = 0; ij < J; ij++) {
+						uint32_t c_index = (bi + ii) * nj + (bj + ij);
+						__m512 acc = _mm512_setzero_ps();
+						for(uint32_t ik = 0; ik < aligned_K; ik += n_avx) {
+							__m512 a_vec = _mm512_load_ps(&block_a[ii * ld + ik]);
+							__m512 b_vec = _mm512_load_ps(&block_b[ij * ld + ik]);
+							acc = _mm512_fmadd_ps(a_vec, b_vec, acc);
 						}
+						__m512 a_vec = _mm512_maskz_loadu_ps(tail, &block_a[ii * ld + aligned_K]);
+						__m512 b_vec = _mm512_maskz_loadu_ps(tail, &block_b[ij * ld + aligned_K]);
+						acc = _mm512_fmadd_ps(a_vec, b_vec, acc);
+						C[c_index] += _mm512_reduce_add_ps(acc);
 					}
 				}
 			}
 		}
-		free(block_a);
-		free(block_b);
 	}
+	cpu_workspace_release(ws, &scratch);
+#endif
+}
+
+void gemm_rrc_blis_avx512(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	gemm_rrc_blis(&BLIS_BEST, userdata, C, A, B, ni, nj, nk);
+}
+
+// builds without AVX2 have nothing to generate code for and run the plain
+// BLIS kernel
+void gemm_rrc_blis_jit(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+#ifdef JIT_ISA
+	gemm_rrc_blis_jit_strided(&BLIS_BEST, userdata, C, nj, A, nk, B, nk, ni, nj, nk);
+#else
+	gemm_rrc_blis(&BLIS_BEST, userdata, C, A, B, ni, nj, nk);
+#endif
+}
+
+// subproblems whose blocks of A, B and C take up to this many bytes are done
+// directly, they fit together in L1 on any recent x86
+#define RECURSIVE_BASE_BYTES (32 * 1024)
+
+#ifdef HAVE_AVX2
+// [sum(a), sum(b), sum(c), sum(d)]
+static inline __m128 hsum4_avx(__m256 a, __m256 b, __m256 c, __m256 d) {
+	__m256 abcd = _mm256_hadd_ps(_mm256_hadd_ps(a, b), _mm256_hadd_ps(c, d));
+	return _mm_add_ps(_mm256_castps256_ps128(abcd), _mm256_extractf128_ps(abcd, 1));
+}
+
+#define DOT_ROW_AVX(r) \
+	c##r##0 = _mm256_fmadd_ps(a##r, b0, c##r##0); \
+	c##r##1 = _mm256_fmadd_ps(a##r, b1, c##r##1); \
+	c##r##2 = _mm256_fmadd_ps(a##r, b2, c##r##2); \
+	c##r##3 = _mm256_fmadd_ps(a##r, b3, c##r##3);
+
+// C[0:m, 0:n] += A[0:m] . B[0:n] for m <= 2 rows of A and n <= 4 columns of B,
+// both contiguous along k. Missing rows and columns repeat the last one and
+// aren't written back
+static inline void dot_2x4_avx(dtype_t* C, uint32_t ldc, dtype_t* A, dtype_t* B, uint32_t ld, uint32_t m, uint32_t n, uint32_t k) {
+	dtype_t* a_row[2] = { A, A + (m > 1) * ld };
+	dtype_t* b_col[4] = { B, B + (n > 1) * ld, B + (n > 2 ? 2 : n - 1) * ld, B + (n > 3 ? 3 : n - 1) * ld };
+	__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps(), c02 = _mm256_setzero_ps(), c03 = _mm256_setzero_ps();
+	__m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps(), c12 = _mm256_setzero_ps(), c13 = _mm256_setzero_ps();
+	uint32_t ik = 0;
+	for(; ik + 8 <= k; ik += 8) {
+		__m256 a0 = _mm256_loadu_ps(a_row[0] + ik), a1 = _mm256_loadu_ps(a_row[1] + ik);
+		__m256 b0 = _mm256_loadu_ps(b_col[0] + ik), b1 = _mm256_loadu_ps(b_col[1] + ik);
+		__m256 b2 = _mm256_loadu_ps(b_col[2] + ik), b3 = _mm256_loadu_ps(b_col[3] + ik);
+		DOT_ROW_AVX(0) DOT_ROW_AVX(1)
+	}
+	if(ik < k) {
+		__m256i mask = mask_avx(k - ik);
+		__m256 a0 = _mm256_maskload_ps(a_row[0] + ik, mask), a1 = _mm256_maskload_ps(a_row[1] + ik, mask);
+		__m256 b0 = _mm256_maskload_ps(b_col[0] + ik, mask), b1 = _mm256_maskload_ps(b_col[1] + ik, mask);
+		__m256 b2 = _mm256_maskload_ps(b_col[2] + ik, mask), b3 = _mm256_maskload_ps(b_col[3] + ik, mask);
+		DOT_ROW_AVX(0) DOT_ROW_AVX(1)
+	}
+	__m128 sums[2] = { hsum4_avx(c00, c01, c02, c03), hsum4_avx(c10, c11, c12, c13) };
+	for(uint32_t r = 0; r < m; r++) {
+		if(n == 4) {
+			_mm_storeu_ps(&C[r * ldc], _mm_add_ps(_mm_loadu_ps(&C[r * ldc]), sums[r]));
+		} else {
+			dtype_t s[4];
+			_mm_storeu_ps(s, sums[r]);
+			for(uint32_t c = 0; c < n; c++) C[r * ldc + c] += s[c];
+		}
+	}
+}
+#endif
+
+// C += A B for a subproblem small enough for L1, with the strides of the
+// whole problem (ld is the row stride of A and the column stride of B)
+static void recursive_base(dtype_t* C, uint32_t ldc, dtype_t* A, dtype_t* B, uint32_t ld, uint32_t ni, uint32_t nj, uint32_t nk) {
+#ifdef HAVE_AVX2
+	for(uint32_t ii = 0; ii < ni; ii += 2) {
+		for(uint32_t ij = 0; ij < nj; ij += 4) {
+			dot_2x4_avx(&C[ii * ldc + ij], ldc, &A[ii * ld], &B[ij * ld], ld, MIN(2, ni - ii), MIN(4, nj - ij), nk);
+		}
+	}
+#else
+	for(uint32_t ii = 0; ii < ni; ii++) {
+		for(uint32_t ij = 0; ij < nj; ij++) {
+			dtype_t sum = 0;
+			for(uint32_t ik = 0; ik < nk; ik++) sum += A[ii * ld + ik] * B[ij * ld + ik];
+			C[ii * ldc + ij] += sum;
+		}
+	}
+#endif
+}
+
+// halves the largest dimension, so at some depth the subproblem fits every
+// level of the cache hierarchy whatever its size
+static void recursive(dtype_t* C, uint32_t ldc, dtype_t* A, dtype_t* B, uint32_t ld, uint32_t ni, uint32_t nj, uint32_t nk) {
+	if(((size_t)ni * nk + (size_t)nj * nk + (size_t)ni * nj) * sizeof(dtype_t) <= RECURSIVE_BASE_BYTES) {
+		recursive_base(C, ldc, A, B, ld, ni, nj, nk);
+	} else if(ni >= nj && ni >= nk) {
+		uint32_t h = ni / 2;
+		recursive(C, ldc, A, B, ld, h, nj, nk);
+		recursive(&C[h * ldc], ldc, &A[h * ld], B, ld, ni - h, nj, nk);
+	} else if(nj >= nk) {
+		uint32_t h = nj / 2;
+		recursive(C, ldc, A, B, ld, ni, h, nk);
+		recursive(&C[h], ldc, A, &B[h * ld], ld, ni, nj - h, nk);
+	} else {
+		uint32_t h = nk / 2;
+		recursive(C, ldc, A, B, ld, ni, nj, h);
+		recursive(C, ldc, &A[h], &B[h], ld, ni, nj, nk - h);
+	}
+}
+
+void gemm_rrc_recursive(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	// C is (ni, nj) row major
+	// A is (ni, nk) row major
+	// B is (nk, nj) column major
+	// cache oblivious: no block sizes to tune and nothing packed, so the
+	// context has nothing to offer
+	(void)userdata;
+	recursive(C, nj, A, B, nk, ni, nj, nk);
+}
+
+// D = X + s Y on (rows, cols) blocks with row strides ldd, ldx and ldy. Blocks
+// of B are the (nj, nk) row major blocks of B^T. D may be X
+static void strassen_add(dtype_t* D, uint32_t ldd, const dtype_t* X, uint32_t ldx, const dtype_t* Y, uint32_t ldy, dtype_t s, uint32_t rows, uint32_t cols) {
+	for(uint32_t i = 0; i < rows; i++) {
+		for(uint32_t j = 0; j < cols; j++) D[(size_t)i * ldd + j] = X[(size_t)i * ldx + j] + s * Y[(size_t)i * ldy + j];
+	}
+}
+
+// what the even (2m, 2n, 2k) part leaves out when dimensions are odd: the last
+// rank-1 update, the last row and the last column of C, done classically
+static void strassen_edges(GemmContext* ctx, uint32_t thread, dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, uint32_t ni, uint32_t nj, uint32_t nk) {
+	uint32_t m = ni & ~1u, n = nj & ~1u, k = nk & ~1u;
+	if(k < nk) {
+		gemm_rrc_blis_strided(&BLIS_BEST, ctx, &tuning_of(ctx)->blis[BLIS_BEST.tuning], thread, C, NULL, ldc, &A[k], lda, &B[k], ldb, m, n, 1);
+	}
+	if(n < nj) {
+		gemm_rrc_blis_strided(&BLIS_BEST, ctx, &tuning_of(ctx)->blis[BLIS_BEST.tuning], thread, &C[n], NULL, ldc, A, lda, &B[(size_t)n * ldb], ldb, m, 1, nk);
+	}
+	if(m < ni) {
+		gemm_rrc_blis_strided(&BLIS_BEST, ctx, &tuning_of(ctx)->blis[BLIS_BEST.tuning], thread, &C[(size_t)m * ldc], NULL, ldc, &A[(size_t)m * lda], lda, B, ldb, 1, nj, nk);
+	}
+}
+
+// C += A B with Winograd's variant (7 products, 15 additions) until a dimension
+// is at most cutoff, then the BLIS kernel. Takes one (m, k), one (k, n) and one
+// (m, n) temporary per level, scheduled as in Boyer et al., "Memory efficient
+// scheduling of Strassen-Winograd's matrix multiplication algorithm"
+static void strassen(GemmContext* ctx, uint32_t thread, uint32_t cutoff, dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, uint32_t ni, uint32_t nj, uint32_t nk) {
+	uint32_t m = ni / 2, n = nj / 2, k = nk / 2;
+	dtype_t* X = NULL;
+	if(MIN(ni, MIN(nj, nk)) <= cutoff || !(X = cpu_alloc(((size_t)m * k + (size_t)k * n + (size_t)m * n) * sizeof(dtype_t)))) {
+		gemm_rrc_blis_strided(&BLIS_BEST, ctx, &tuning_of(ctx)->blis[BLIS_BEST.tuning], thread, C, NULL, ldc, A, lda, B, ldb, ni, nj, nk);
+		return;
+	}
+	dtype_t* Y = X + (size_t)m * k, *Z = Y + (size_t)k * n;
+	dtype_t* A11 = A, *A12 = &A[k], *A21 = &A[(size_t)m * lda], *A22 = &A21[k];
+	dtype_t* B11 = B, *B21 = &B[k], *B12 = &B[(size_t)n * ldb], *B22 = &B12[k];
+	dtype_t* C11 = C, *C12 = &C[n], *C21 = &C[(size_t)m * ldc], *C22 = &C21[n];
+	// P5 = S1 T1, into C12 and C22
+	strassen_add(X, k, A21, lda, A22, lda, 1, m, k);
+	strassen_add(Y, k, B12, ldb, B11, ldb, -1, n, k);
+	memset(Z, 0, (size_t)m * n * sizeof(dtype_t));
+	strassen(ctx, thread, cutoff, Z, n, X, k, Y, k, m, n, k);
+	strassen_add(C12, ldc, C12, ldc, Z, n, 1, m, n);
+	strassen_add(C22, ldc, C22, ldc, Z, n, 1, m, n);
+	// P1 into C11, then P1 + P6 = P1 + S2 T2 into C12, C21 and C22
+	strassen_add(X, k, X, k, A11, lda, -1, m, k);
+	strassen_add(Y, k, B22, ldb, Y, k, -1, n, k);
+	memset(Z, 0, (size_t)m * n * sizeof(dtype_t));
+	strassen(ctx, thread, cutoff, Z, n, A11, lda, B11, ldb, m, n, k);
+	strassen_add(C11, ldc, C11, ldc, Z, n, 1, m, n);
+	strassen(ctx, thread, cutoff, Z, n, X, k, Y, k, m, n, k);
+	strassen_add(C12, ldc, C12, ldc, Z, n, 1, m, n);
+	strassen_add(C21, ldc, C21, ldc, Z, n, 1, m, n);
+	strassen_add(C22, ldc, C22, ldc, Z, n, 1, m, n);
+	// P2 = A12 B21 into C11
+	strassen(ctx, thread, cutoff, C11, ldc, A12, lda, B21, ldb, m, n, k);
+	// P3 = S4 B22 into C12
+	strassen_add(X, k, A12, lda, X, k, -1, m, k);
+	strassen(ctx, thread, cutoff, C12, ldc, X, k, B22, ldb, m, n, k);
+	// -P4 = A22 (B21 - T2) into C21
+	strassen_add(Y, k, B21, ldb, Y, k, -1, n, k);
+	strassen(ctx, thread, cutoff, C21, ldc, A22, lda, Y, k, m, n, k);
+	// P7 = S3 T3 into C21 and C22
+	strassen_add(X, k, A11, lda, A21, lda, -1, m, k);
+	strassen_add(Y, k, B22, ldb, B12, ldb, -1, n, k);
+	memset(Z, 0, (size_t)m * n * sizeof(dtype_t));
+	strassen(ctx, thread, cutoff, Z, n, X, k, Y, k, m, n, k);
+	strassen_add(C21, ldc, C21, ldc, Z, n, 1, m, n);
+	strassen_add(C22, ldc, C22, ldc, Z, n, 1, m, n);
+	cpu_free(X);
+	strassen_edges(ctx, thread, C, ldc, A, lda, B, ldb, ni, nj, nk);
+}
+
+// the first level with the 7 products as OpenMP tasks, each in its own
+// temporary, and the levels below them sequential inside the tasks
+static void strassen_parallel(GemmContext* ctx, uint32_t n_threads, uint32_t cutoff, dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, uint32_t ni, uint32_t nj, uint32_t nk) {
+	uint32_t m = ni / 2, n = nj / 2, k = nk / 2;
+	size_t mk = (size_t)m * k, kn = (size_t)k * n, mn = (size_t)m * n;
+	dtype_t* S = NULL;
+	if(MIN(ni, MIN(nj, nk)) <= cutoff || !(S = cpu_calloc(4 * mk + 4 * kn + 7 * mn, sizeof(dtype_t)))) {
+		// the sequential schedule needs a fraction of the memory
+		strassen(ctx, 0, cutoff, C, ldc, A, lda, B, ldb, ni, nj, nk);
+		return;
+	}
+	dtype_t* T = S + 4 * mk, *P = T + 4 * kn;
+	dtype_t* A11 = A, *A12 = &A[k], *A21 = &A[(size_t)m * lda], *A22 = &A21[k];
+	dtype_t* B11 = B, *B21 = &B[k], *B12 = &B[(size_t)n * ldb], *B22 = &B12[k];
+	dtype_t* C11 = C, *C12 = &C[n], *C21 = &C[(size_t)m * ldc], *C22 = &C21[n];
+	strassen_add(S, k, A21, lda, A22, lda, 1, m, k);
+	strassen_add(S + mk, k, S, k, A11, lda, -1, m, k);
+	strassen_add(S + 2 * mk, k, A11, lda, A21, lda, -1, m, k);
+	strassen_add(S + 3 * mk, k, A12, lda, S + mk, k, -1, m, k);
+	strassen_add(T, k, B12, ldb, B11, ldb, -1, n, k);
+	strassen_add(T + kn, k, B22, ldb, T, k, -1, n, k);
+	strassen_add(T + 2 * kn, k, B22, ldb, B12, ldb, -1, n, k);
+	strassen_add(T + 3 * kn, k, T + kn, k, B21, ldb, -1, n, k);
+	// operands of P1..P7
+	struct { dtype_t* a; uint32_t lda; dtype_t* b; uint32_t ldb; } products[7] = {
+		{ A11, lda, B11, ldb },
+		{ A12, lda, B21, ldb },
+		{ S + 3 * mk, k, B22, ldb },
+		{ A22, lda, T + 3 * kn, k },
+		{ S, k, T, k },
+		{ S + mk, k, T + kn, k },
+		{ S + 2 * mk, k, T + 2 * kn, k },
+	};
+	#pragma omp parallel num_threads(n_threads)
+	#pragma omp single
+	for(uint32_t p = 0; p < 7; p++) {
+		#pragma omp task
+		strassen(ctx, omp_get_thread_num(), cutoff, P + p * mn, n, products[p].a, products[p].lda, products[p].b, products[p].ldb, m, n, k);
+	}
+	dtype_t* P1 = P, *P2 = P + mn, *P3 = P + 2 * mn, *P4 = P + 3 * mn, *P5 = P + 4 * mn, *P6 = P + 5 * mn, *P7 = P + 6 * mn;
+	#pragma omp parallel for num_threads(n_threads)
+	for(uint32_t i = 0; i < m; i++) {
+		for(uint32_t j = 0; j < n; j++) {
+			size_t x = (size_t)i * n + j;
+			dtype_t u2 = P1[x] + P6[x], u3 = u2 + P7[x];
+			C11[(size_t)i * ldc + j] += P1[x] + P2[x];
+			C12[(size_t)i * ldc + j] += u2 + P5[x] + P3[x];
+			C21[(size_t)i * ldc + j] += u3 - P4[x];
+			C22[(size_t)i * ldc + j] += u3 + P5[x];
+		}
+	}
+	cpu_free(S);
+	strassen_edges(ctx, 0, C, ldc, A, lda, B, ldb, ni, nj, nk);
+}
+
+void gemm_rrc_strassen(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	// C is (ni, nj) row major
+	// A is (ni, nk) row major
+	// B is (nk, nj) column major
+	GemmContext* ctx = userdata;
+	uint32_t cutoff = MAX(1, tuning_of(ctx)->strassen_cutoff);
+	uint32_t n_threads = ctx ? ctx->n_threads : (uint32_t)omp_get_max_threads();
+	if(n_threads > 1) {
+		strassen_parallel(ctx, n_threads, cutoff, C, nj, A, nk, B, nk, ni, nj, nk);
+	} else {
+		strassen(ctx, 0, cutoff, C, nj, A, nk, B, nk, ni, nj, nk);
+	}
+}
+
+// GEMV does 2 flops per element of A it streams, so it runs at memory speed
+// whatever the kernel. What matters is reading A once, in order, with enough
+// loads in flight: several rows (or columns) at a time, software prefetch
+// ahead of the hardware streams and the threads each on their own rows
+
+// this many elements ahead of the loads
+#define GEMV_PREFETCH 256
+// rows of y kept in L1 while the columns of a column major A go by
+#define GEMV_BLOCK 2048
+
+#ifdef HAVE_AVX2
+#define GEMV_ROW_AVX(r) \
+	c##r##0 = _mm256_fmadd_ps(_mm256_loadu_ps(a_row[r] + ik), x0, c##r##0); \
+	c##r##1 = _mm256_fmadd_ps(_mm256_loadu_ps(a_row[r] + ik + 8), x1, c##r##1); \
+	_mm_prefetch((const char*)(a_row[r] + ik + GEMV_PREFETCH), _MM_HINT_T0);
+
+#define GEMV_ROW_TAIL_AVX(r) \
+	c##r##0 = _mm256_fmadd_ps(_mm256_maskload_ps(a_row[r] + ik, mask), x0, c##r##0);
+
+// y[0:m] += A[0:m] . x for m <= 4 rows of a row major A, two accumulators a row.
+// Missing rows repeat the last one and aren't written back
+static void gemv_rows_avx(dtype_t* y, dtype_t* A, uint32_t lda, dtype_t* x, uint32_t m, uint32_t nk) {
+	dtype_t* a_row[4] = { A, A + (m > 1) * lda, A + (m > 2 ? 2 : m - 1) * lda, A + (m > 3 ? 3 : m - 1) * lda };
+	__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps(), c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+	__m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps(), c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+	uint32_t ik = 0;
+	for(; ik + 16 <= nk; ik += 16) {
+		__m256 x0 = _mm256_loadu_ps(x + ik), x1 = _mm256_loadu_ps(x + ik + 8);
+		GEMV_ROW_AVX(0) GEMV_ROW_AVX(1) GEMV_ROW_AVX(2) GEMV_ROW_AVX(3)
+	}
+	for(; ik < nk; ik += 8) {
+		__m256i mask = mask_avx(nk - ik);
+		__m256 x0 = _mm256_maskload_ps(x + ik, mask);
+		GEMV_ROW_TAIL_AVX(0) GEMV_ROW_TAIL_AVX(1) GEMV_ROW_TAIL_AVX(2) GEMV_ROW_TAIL_AVX(3)
+	}
+	__m128 sums = hsum4_avx(_mm256_add_ps(c00, c01), _mm256_add_ps(c10, c11), _mm256_add_ps(c20, c21), _mm256_add_ps(c30, c31));
+	if(m == 4) {
+		_mm_storeu_ps(y, _mm_add_ps(_mm_loadu_ps(y), sums));
+	} else {
+		dtype_t s[4];
+		_mm_storeu_ps(s, sums);
+		for(uint32_t r = 0; r < m; r++) y[r] += s[r];
+	}
+}
+
+// y[0:m] += A[0:m, k:k+4] x[k:k+4] for 4 columns of a column major A, so every
+// vector of y is loaded and stored once per 4 columns
+static void gemv_cols_avx(dtype_t* y, dtype_t* A, uint32_t lda, dtype_t* x, uint32_t m) {
+	dtype_t* a_col[4] = { A, A + lda, A + 2 * lda, A + 3 * lda };
+	__m256 x0 = _mm256_broadcast_ss(x), x1 = _mm256_broadcast_ss(x + 1);
+	__m256 x2 = _mm256_broadcast_ss(x + 2), x3 = _mm256_broadcast_ss(x + 3);
+	uint32_t i = 0;
+	for(; i + 8 <= m; i += 8) {
+		for(uint32_t c = 0; c < 4; c++) _mm_prefetch((const char*)(a_col[c] + i + GEMV_PREFETCH), _MM_HINT_T0);
+		__m256 s = _mm256_mul_ps(_mm256_loadu_ps(a_col[0] + i), x0);
+		__m256 t = _mm256_mul_ps(_mm256_loadu_ps(a_col[1] + i), x1);
+		s = _mm256_fmadd_ps(_mm256_loadu_ps(a_col[2] + i), x2, s);
+		t = _mm256_fmadd_ps(_mm256_loadu_ps(a_col[3] + i), x3, t);
+		_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_add_ps(s, t)));
+	}
+	if(i < m) {
+		__m256i mask = mask_avx(m - i);
+		__m256 s = _mm256_mul_ps(_mm256_maskload_ps(a_col[0] + i, mask), x0);
+		__m256 t = _mm256_mul_ps(_mm256_maskload_ps(a_col[1] + i, mask), x1);
+		s = _mm256_fmadd_ps(_mm256_maskload_ps(a_col[2] + i, mask), x2, s);
+		t = _mm256_fmadd_ps(_mm256_maskload_ps(a_col[3] + i, mask), x3, t);
+		_mm256_maskstore_ps(y + i, mask, _mm256_add_ps(_mm256_maskload_ps(y + i, mask), _mm256_add_ps(s, t)));
+	}
+}
+#endif
+
+void gemv_r(void* userdata, dtype_t* y, dtype_t* A, dtype_t* x, uint32_t ni, uint32_t nk) {
+	// y is (ni)
+	// A is (ni, nk) row major
+	// x is (nk)
+	#pragma omp parallel for num_threads(cpu_gemm_threads(userdata, ni, 1, nk)) schedule(static)
+	for(uint32_t i = 0; i < ni; i += 4) {
+#ifdef HAVE_AVX2
+		gemv_rows_avx(&y[i], &A[(size_t)i * nk], nk, x, MIN(4, ni - i), nk);
+#else
+		for(uint32_t r = i; r < MIN(i + 4, ni); r++) {
+			dtype_t* a = &A[(size_t)r * nk];
+			// four partial sums, for the loads in flight
+			dtype_t s[4] = {0};
+			uint32_t ik = 0;
+			for(; ik + 4 <= nk; ik += 4) {
+				for(uint32_t u = 0; u < 4; u++) s[u] += a[ik + u] * x[ik + u];
+			}
+			for(; ik < nk; ik++) s[0] += a[ik] * x[ik];
+			y[r] += (s[0] + s[1]) + (s[2] + s[3]);
+		}
+#endif
+	}
+}
+
+void gemv_c(void* userdata, dtype_t* y, dtype_t* A, dtype_t* x, uint32_t ni, uint32_t nk) {
+	// y is (ni)
+	// A is (ni, nk) column major
+	// x is (nk)
+	#pragma omp parallel for num_threads(cpu_gemm_threads(userdata, ni, 1, nk)) schedule(static)
+	for(uint32_t bi = 0; bi < ni; bi += GEMV_BLOCK) {
+		uint32_t m = MIN(GEMV_BLOCK, ni - bi);
+		uint32_t ik = 0;
+#ifdef HAVE_AVX2
+		for(; ik + 4 <= nk; ik += 4) {
+			gemv_cols_avx(&y[bi], &A[(size_t)ik * ni + bi], ni, &x[ik], m);
+		}
+#endif
+		for(; ik < nk; ik++) {
+			dtype_t* a = &A[(size_t)ik * ni + bi];
+			for(uint32_t i = 0; i < m; i++) y[bi + i] += a[i] * x[ik];
+		}
+	}
+}
+
+// rank-k updates (nk up to this) do 2 nk flops per element of C they load and
+// store, so they are bound by the traffic of C like GEMV is by that of A.
+// Packing for the micro-kernels only adds to it: C is streamed once instead,
+// every vector of it updated with all of A B in registers
+#define RANK_K_MAX 16
+// a tile of C per task: its rows of A and the RANK_K_NC columns of B^T
+// transposed for it stay in L1 while its rows go by
+#define RANK_K_MC 64
+#define RANK_K_NC 512
+
+#ifdef HAVE_AVX2
+// the lanes of bt past n are zeros, loaded with the others but never stored
+#define RANK_K_MASKED_ROW_AVX(r) { \
+		__m256 c = _mm256_maskload_ps(&C[r * ldc + j], mask); \
+		for(uint32_t ik = 0; ik < nk; ik++) { \
+			c = _mm256_fmadd_ps(_mm256_broadcast_ss(&A[r * lda + ik]), _mm256_load_ps(&bt[ik * ldt + j]), c); \
+		} \
+		_mm256_maskstore_ps(&C[r * ldc + j], mask, c); \
+	}
+
+// C[0:m, 0:n] += A[0:m, 0:nk] bt[0:nk, 0:n], 4 rows of C a vector at a time so
+// every vector of bt loaded is used 4 times
+static void rank_k_rows_avx(dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, dtype_t* bt, uint32_t ldt, uint32_t m, uint32_t n, uint32_t nk) {
+	uint32_t i = 0;
+	for(; i + 4 <= m; i += 4, C += 4 * ldc, A += 4 * lda) {
+		uint32_t j = 0;
+		for(; j + 8 <= n; j += 8) {
+			__m256 c00 = _mm256_loadu_ps(&C[j]), c10 = _mm256_loadu_ps(&C[ldc + j]);
+			__m256 c20 = _mm256_loadu_ps(&C[2 * ldc + j]), c30 = _mm256_loadu_ps(&C[3 * ldc + j]);
+			for(uint32_t ik = 0; ik < nk; ik++) {
+				__m256 b = _mm256_load_ps(&bt[ik * ldt + j]);
+				c00 = _mm256_fmadd_ps(_mm256_broadcast_ss(&A[ik]), b, c00);
+				c10 = _mm256_fmadd_ps(_mm256_broadcast_ss(&A[lda + ik]), b, c10);
+				c20 = _mm256_fmadd_ps(_mm256_broadcast_ss(&A[2 * lda + ik]), b, c20);
+				c30 = _mm256_fmadd_ps(_mm256_broadcast_ss(&A[3 * lda + ik]), b, c30);
+			}
+			_mm256_storeu_ps(&C[j], c00);
+			_mm256_storeu_ps(&C[ldc + j], c10);
+			_mm256_storeu_ps(&C[2 * ldc + j], c20);
+			_mm256_storeu_ps(&C[3 * ldc + j], c30);
+		}
+		if(j < n) {
+			__m256i mask = mask_avx(n - j);
+			RANK_K_MASKED_ROW_AVX(0) RANK_K_MASKED_ROW_AVX(1)
+			RANK_K_MASKED_ROW_AVX(2) RANK_K_MASKED_ROW_AVX(3)
+		}
+	}
+	for(; i < m; i++, C += ldc, A += lda) {
+		for(uint32_t j = 0; j < n; j += 8) {
+			__m256i mask = mask_avx(n - j);
+			RANK_K_MASKED_ROW_AVX(0)
+		}
+	}
+}
+#endif
+
+// C += A B for nk <= RANK_K_MAX, tiles of C shared out between the threads
+// over both dimensions, so the longer one gives them their work
+static void gemm_rrc_rank_k(GemmContext* ctx, uint32_t n_threads, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	#pragma omp parallel num_threads(n_threads)
+	{
+		GemmWorkspace scratch;
+		GemmWorkspace* ws = cpu_workspace_acquire(ctx, omp_get_thread_num(), 0, RANK_K_MAX * RANK_K_NC, &scratch);
+		dtype_t* bt = ws ? ws->block_b : NULL;
+		#pragma omp for collapse(2) schedule(static)
+		for(uint32_t bi = 0; bi < ni; bi += RANK_K_MC) {
+			for(uint32_t bj = 0; bj < nj; bj += RANK_K_NC) {
+				uint32_t I = MIN(RANK_K_MC, ni - bi), J = MIN(RANK_K_NC, nj - bj);
+				if(!bt) {
+					gemm_unpacked(&C[(size_t)bi * nj + bj], nj, &A[(size_t)bi * nk], nk, 1, &B[(size_t)bj * nk], 1, nk, 1, I, J, nk);
+					continue;
+				}
+				// --- Transpose the columns of B into the rows of bt ---
+				transpose_block(bt, RANK_K_NC, &B[(size_t)bj * nk], nk, J, nk);
+				zero_tail(bt, RANK_K_NC, nk, J, ALIGN_UP(J, 8));
+#ifdef HAVE_AVX2
+				rank_k_rows_avx(&C[(size_t)bi * nj + bj], nj, &A[(size_t)bi * nk], nk, bt, RANK_K_NC, I, J, nk);
+#else
+				for(uint32_t i = bi; i < bi + I; i++) {
+					for(uint32_t ik = 0; ik < nk; ik++) {
+						dtype_t a = A[(size_t)i * nk + ik];
+						for(uint32_t j = 0; j < J; j++) C[(size_t)i * nj + bj + j] += a * bt[ik * RANK_K_NC + j];
+					}
+				}
+#endif
+			}
+		}
+		if(ws) {
+			cpu_workspace_release(ws, &scratch);
+		}
+	}
+}
+
+// slices of nk for gemm_rrc_split_k. Strips of C make every thread read all of
+// the operand that isn't split (n_threads times the traffic), which only pays
+// when C is long compared to nk. So nk is cut into slices at least as deep as
+// C is long (and a KC panel), one per thread at most
+static uint32_t split_k_count(uint32_t ni, uint32_t nj, uint32_t nk, uint32_t n_threads, uint32_t kc) {
+	uint32_t depth = MAX(MAX(ni, nj), kc);
+	return MAX(1, MIN(n_threads, nk / depth));
+}
+
+// C += A B as the sum of the products over splits slices of nk (whole KC
+// panels of t), shared out between n_threads threads: the first slice is added
+// into C, the others into zeroed partial buffers, which are then added pairwise
+// in log2(splits) rounds, every thread on every add. The result depends on
+// splits but not on n_threads. With E every partial gets compensation terms of
+// its own, the additions of the tree are compensated too and E ends up with
+// all of them. -1 when the partials couldn't be allocated
+static int gemm_rrc_split_k(const BlisConfig* cfg, GemmContext* ctx, const BlisTuning* t, uint32_t n_threads, uint32_t splits, dtype_t* C, dtype_t* E, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	uint32_t slice = ALIGN_UP((nk + splits - 1) / splits, t->kc);
+	splits = (nk + slice - 1) / slice;
+	size_t mn = (size_t)ni * nj;
+	dtype_t* partials = cpu_alloc((splits - 1) * mn * (E ? 2 : 1) * sizeof(dtype_t));
+	if(!partials) {
+		return -1;
+	}
+	// the compensation terms of the partials follow them
+	dtype_t* errors = &partials[(splits - 1) * mn];
+	#pragma omp parallel num_threads(MIN(n_threads, splits))
+	{
+		uint32_t thread = omp_get_thread_num();
+		#pragma omp for schedule(static)
+		for(uint32_t s = 0; s < splits; s++) {
+			uint32_t k = s * slice;
+			dtype_t* P = s ? &partials[(s - 1) * mn] : C;
+			dtype_t* PE = !E ? NULL : s ? &errors[(s - 1) * mn] : E;
+			if(s) {
+				memset(P, 0, mn * sizeof(dtype_t));
+			}
+			if(s && E) {
+				memset(PE, 0, mn * sizeof(dtype_t));
+			}
+			gemm_rrc_blis_strided(cfg, ctx, t, thread, P, PE, nj, &A[k], nk, &B[k], nk, ni, nj, MIN(slice, nk - k));
+		}
+		for(uint32_t stride = 1; stride < splits; stride *= 2) {
+			for(uint32_t p = 0; p + stride < splits; p += 2 * stride) {
+				dtype_t* dst = p ? &partials[(p - 1) * mn] : C;
+				dtype_t* src = &partials[(p + stride - 1) * mn];
+				if(E) {
+					dtype_t* dst_e = p ? &errors[(p - 1) * mn] : E;
+					dtype_t* src_e = &errors[(p + stride - 1) * mn];
+					#pragma omp for schedule(static)
+					for(uint32_t i = 0; i < ni; i++) {
+						compensated_add(&dst[(size_t)i * nj], &dst_e[(size_t)i * nj], nj, &src[(size_t)i * nj], nj, 1, nj);
+						for(uint32_t j = 0; j < nj; j++) dst_e[(size_t)i * nj + j] += src_e[(size_t)i * nj + j];
+					}
+				} else {
+					#pragma omp for schedule(static)
+					for(size_t i = 0; i < mn; i++) {
+						dst[i] += src[i];
+					}
+				}
+			}
+		}
+	}
+	cpu_free(partials);
+	return 0;
+}
+
+static void gemm_rrc_strips(const BlisConfig* cfg, GemmContext* ctx, const BlisTuning* t, uint32_t n_threads, dtype_t* C, dtype_t* E, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	gemm_blis_strips(cfg, ctx, t, n_threads, C, E, nj, A, nk, 1, B, 1, nk, 1, 1, ni, nj, nk);
+}
+
+static inline int reproducible(GemmContext* ctx) {
+	return ctx ? ctx->reproducible : cpu_reproducible();
+}
+
+// the reproducible mode: every element of C gets C + the sum of its slices
+// (split_k_count for REPRO_SPLITS threads, whatever the real count), each slice
+// the sum of its REPRO_KC panels, each panel one fused multiply-add per k from
+// zero in k order. The micro-kernels of BLIS_REPRODUCIBLE compute exactly that
+// for any MR x NR tile, so neither the strips nor the ISA change a bit
+static BlisTuning reproducible_tuning(GemmContext* ctx) {
+	const BlisConfig* cfg = &BLIS_REPRODUCIBLE;
+	BlisTuning t = tuning_of(ctx)->blis[cfg->tuning];
+	t.kc = REPRO_KC;
+	// the packed blocks of A and B take whole micro-panels, and the tuning may
+	// be for other ones
+	t.mc = MAX(cfg->mr, t.mc / cfg->mr * cfg->mr);
+	t.nc = MAX(cfg->nr, t.nc / cfg->nr * cfg->nr);
+	return t;
+}
+
+static void gemm_rrc_reproducible(GemmContext* ctx, uint32_t n_threads, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	const BlisConfig* cfg = &BLIS_REPRODUCIBLE;
+	BlisTuning t = reproducible_tuning(ctx);
+	uint32_t splits = split_k_count(ni, nj, nk, REPRO_SPLITS, REPRO_KC);
+	if(splits > 1 && !gemm_rrc_split_k(cfg, ctx, &t, n_threads, splits, C, NULL, A, B, ni, nj, nk)) {
+		return;
+	}
+	gemm_rrc_strips(cfg, ctx, &t, n_threads, C, NULL, A, B, ni, nj, nk);
+}
+
+void gemm_rrc_blis_omp(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	// C is (ni, nj) row major
+	// A is (ni, nk) row major
+	// B is (nk, nj) column major
+	GemmContext* ctx = userdata;
+	uint32_t n_threads = cpu_gemm_threads(ctx, ni, nj, nk);
+	if(reproducible(ctx)) {
+		gemm_rrc_reproducible(ctx, n_threads, C, A, B, ni, nj, nk);
+		return;
+	}
+	if(nk <= RANK_K_MAX) {
+		gemm_rrc_rank_k(ctx, n_threads, C, A, B, ni, nj, nk);
+		return;
+	}
+	const BlisTuning* t = &tuning_of(ctx)->blis[BLIS_BEST.tuning];
+	// the cached panels are shared by all the strips, whose nk is never split
+	if(ctx && ctx->pack_cache.budget) {
+		gemm_rrc_blis_cached(&BLIS_BEST, ctx, t, n_threads, C, A, B, ni, nj, nk);
+		return;
+	}
+	if(n_threads == 1) {
+		gemm_rrc_blis(&BLIS_BEST, ctx, C, A, B, ni, nj, nk);
+		return;
+	}
+	uint32_t splits = split_k_count(ni, nj, nk, n_threads, t->kc);
+	if(splits > 1 && !gemm_rrc_split_k(&BLIS_BEST, ctx, t, n_threads, splits, C, NULL, A, B, ni, nj, nk)) {
+		return;
+	}
+	gemm_rrc_strips(&BLIS_BEST, ctx, t, n_threads, C, NULL, A, B, ni, nj, nk);
+}
+
+void gemm_rrc_blis_compensated(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	// C is (ni, nj) row major
+	// A is (ni, nk) row major
+	// B is (nk, nj) column major
+	if(!ni || !nj) {
+		return;
+	}
+	GemmContext* ctx = userdata;
+	uint32_t n_threads = cpu_gemm_threads(ctx, ni, nj, nk);
+	size_t mn = (size_t)ni * nj;
+	dtype_t* E = cpu_calloc(mn, sizeof(dtype_t));
+	if(!E) {
+		gemm_rrc_blis_omp(userdata, C, A, B, ni, nj, nk);
+		return;
+	}
+	const BlisTuning* t = &tuning_of(ctx)->blis[BLIS_BEST.tuning];
+	uint32_t splits = split_k_count(ni, nj, nk, n_threads, t->kc);
+	if(splits <= 1 || gemm_rrc_split_k(&BLIS_BEST, ctx, t, n_threads, splits, C, E, A, B, ni, nj, nk)) {
+		gemm_rrc_strips(&BLIS_BEST, ctx, t, n_threads, C, E, A, B, ni, nj, nk);
+	}
+	// the rounding errors of every addition into C, added back once
+	#pragma omp parallel for num_threads(n_threads) schedule(static)
+	for(size_t i = 0; i < mn; i++) {
+		C[i] += E[i];
+	}
+	cpu_free(E);
+}
+
+// problems with every dimension at most this are done by the unrolled kernels
+// below when nj and nk are one of their sizes
+#define SMALL_MAX 32
+
+#ifdef HAVE_AVX2
+// rows x nj block of C (rows a constant, m <= rows of them real) from the
+// transposed B, rows x ceil(nj / 8) ymm accumulators. Missing rows repeat the
+// last one and aren't written back
+static inline __attribute__((always_inline)) void small_rows_avx(dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, const dtype_t* bt, uint32_t ldt, uint32_t m, uint32_t nj, uint32_t nk, uint32_t rows) {
+	uint32_t nv = (nj + 7) / 8;
+	const dtype_t* a_row[8];
+	__m256 acc[8][4];
+	_Pragma("GCC unroll 8")
+	for(uint32_t r = 0; r < rows; r++) {
+		a_row[r] = &A[MIN(r, m - 1) * lda];
+		_Pragma("GCC unroll 4")
+		for(uint32_t v = 0; v < nv; v++) acc[r][v] = _mm256_setzero_ps();
+	}
+	_Pragma("GCC unroll 4")
+	for(uint32_t ik = 0; ik < nk; ik++) {
+		_Pragma("GCC unroll 8")
+		for(uint32_t r = 0; r < rows; r++) {
+			__m256 a = _mm256_broadcast_ss(&a_row[r][ik]);
+			_Pragma("GCC unroll 4")
+			for(uint32_t v = 0; v < nv; v++) acc[r][v] = _mm256_fmadd_ps(a, _mm256_load_ps(&bt[ik * ldt + v * 8]), acc[r][v]);
+		}
+	}
+	__m256i mask = mask_avx(nj % 8);
+	_Pragma("GCC unroll 8")
+	for(uint32_t r = 0; r < rows; r++) {
+		if(r >= m) {
+			break;
+		}
+		_Pragma("GCC unroll 4")
+		for(uint32_t v = 0; v < nv; v++) {
+			dtype_t* c = &C[r * ldc + v * 8];
+			if(v * 8 + 8 <= nj) {
+				_mm256_storeu_ps(c, _mm256_add_ps(_mm256_loadu_ps(c), acc[r][v]));
+			} else {
+				_mm256_maskstore_ps(c, mask, _mm256_add_ps(_mm256_maskload_ps(c, mask), acc[r][v]));
+			}
+		}
+	}
+}
+#elif defined(HAVE_SSE2)
+// the same with xmm accumulators, every size is a multiple of 4 so no masking
+static inline __attribute__((always_inline)) void small_rows_sse2(dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, const dtype_t* bt, uint32_t ldt, uint32_t m, uint32_t nj, uint32_t nk, uint32_t rows) {
+	uint32_t nv = nj / 4;
+	const dtype_t* a_row[8];
+	__m128 acc[8][8];
+	_Pragma("GCC unroll 8")
+	for(uint32_t r = 0; r < rows; r++) {
+		a_row[r] = &A[MIN(r, m - 1) * lda];
+		_Pragma("GCC unroll 8")
+		for(uint32_t v = 0; v < nv; v++) acc[r][v] = _mm_setzero_ps();
+	}
+	_Pragma("GCC unroll 4")
+	for(uint32_t ik = 0; ik < nk; ik++) {
+		_Pragma("GCC unroll 8")
+		for(uint32_t r = 0; r < rows; r++) {
+			__m128 a = _mm_set1_ps(a_row[r][ik]);
+			_Pragma("GCC unroll 8")
+			for(uint32_t v = 0; v < nv; v++) acc[r][v] = _mm_add_ps(acc[r][v], _mm_mul_ps(a, _mm_load_ps(&bt[ik * ldt + v * 4])));
+		}
+	}
+	_Pragma("GCC unroll 8")
+	for(uint32_t r = 0; r < rows; r++) {
+		if(r >= m) {
+			break;
+		}
+		_Pragma("GCC unroll 8")
+		for(uint32_t v = 0; v < nv; v++) _mm_storeu_ps(&C[r * ldc + v * 4], _mm_add_ps(_mm_loadu_ps(&C[r * ldc + v * 4]), acc[r][v]));
+	}
+}
+#endif
+
+// C += A B with nj and nk constant in every instantiation, so the loops over
+// them unroll completely and leave no tails. B is transposed onto the stack and
+// every row of A broadcast against its rows, nothing is allocated or packed
+static inline __attribute__((always_inline)) void small_kernel(dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, uint32_t ni, uint32_t nj, uint32_t nk) {
+	uint32_t ldt = ALIGN_UP(nj, PACK_ALIGN);
+	dtype_t bt[SMALL_MAX * SMALL_MAX] __attribute__((aligned(GEMM_ALIGNMENT)));
+	transpose_block(bt, ldt, B, ldb, nj, nk);
+	zero_tail(bt, ldt, nk, nj, ldt);
+#ifdef HAVE_AVX2
+	// at most 8 accumulators, the rest of the 16 ymm registers hold B and A
+	uint32_t rows = 8 / ((nj + 7) / 8);
+	for(uint32_t ii = 0; ii < ni; ii += rows) {
+		small_rows_avx(&C[ii * ldc], ldc, &A[ii * lda], lda, bt, ldt, MIN(rows, ni - ii), nj, nk, rows);
+	}
+#elif defined(HAVE_SSE2)
+	uint32_t rows = MAX(1, 8 / (nj / 4));
+	for(uint32_t ii = 0; ii < ni; ii += rows) {
+		small_rows_sse2(&C[ii * ldc], ldc, &A[ii * lda], lda, bt, ldt, MIN(rows, ni - ii), nj, nk, rows);
+	}
+#else
+	for(uint32_t ii = 0; ii < ni; ii++) {
+		dtype_t acc[SMALL_MAX] = {0};
+		for(uint32_t ik = 0; ik < nk; ik++) {
+			dtype_t a = A[ii * lda + ik];
+			for(uint32_t ij = 0; ij < nj; ij++) acc[ij] += a * bt[ik * ldt + ij];
+		}
+		for(uint32_t ij = 0; ij < nj; ij++) C[ii * ldc + ij] += acc[ij];
+	}
+#endif
+}
+
+typedef void (*SmallKernel)(dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, uint32_t ni);
+
+// one kernel per (nj, nk) pair of sizes, ni stays a variable
+#define DEFINE_SMALL(nj, nk) \
+	static void small_##nj##x##nk(dtype_t* C, uint32_t ldc, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, uint32_t ni) { \
+		small_kernel(C, ldc, A, lda, B, ldb, ni, nj, nk); \
+	}
+#define DEFINE_SMALL_ROW(nj) \
+	DEFINE_SMALL(nj, 4) DEFINE_SMALL(nj, 8) DEFINE_SMALL(nj, 12) \
+	DEFINE_SMALL(nj, 16) DEFINE_SMALL(nj, 24) DEFINE_SMALL(nj, 32)
+#define SMALL_ROW(nj) { small_##nj##x4, small_##nj##x8, small_##nj##x12, small_##nj##x16, small_##nj##x24, small_##nj##x32 }
+
+DEFINE_SMALL_ROW(4)
+DEFINE_SMALL_ROW(8)
+DEFINE_SMALL_ROW(12)
+DEFINE_SMALL_ROW(16)
+DEFINE_SMALL_ROW(24)
+DEFINE_SMALL_ROW(32)
+
+// indexed by small_index(nj) and small_index(nk)
+static const SmallKernel small_kernels[6][6] = {
+	SMALL_ROW(4), SMALL_ROW(8), SMALL_ROW(12), SMALL_ROW(16), SMALL_ROW(24), SMALL_ROW(32),
+};
+
+static int small_index(uint32_t n) {
+	switch(n) {
+		case 4: return 0;
+		case 8: return 1;
+		case 12: return 2;
+		case 16: return 3;
+		case 24: return 4;
+		case 32: return 5;
+		default: return -1;
+	}
+}
+
+// the unrolled kernel for the shape, NULL when there is none
+static SmallKernel small_kernel_for(uint32_t ni, uint32_t nj, uint32_t nk) {
+	int j = small_index(nj), k = small_index(nk);
+	return ni <= SMALL_MAX && j >= 0 && k >= 0 ? small_kernels[j][k] : NULL;
+}
+
+void gemm_rrc(void* userdata, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uint32_t nj, uint32_t nk) {
+	// the GEMV and unrolled kernels sum in orders of their own
+	if(reproducible(userdata)) {
+		gemm_rrc_blis_omp(userdata, C, A, B, ni, nj, nk);
+		return;
+	}
+	// a single column of C is A times the column of B, a single row is B^T
+	// (row major, as B is column major) times the row of A
+	if(nj == 1) {
+		gemv_r(userdata, C, A, B, ni, nk);
+		return;
+	}
+	if(ni == 1) {
+		gemv_r(userdata, C, B, A, nj, nk);
+		return;
+	}
+	SmallKernel small = small_kernel_for(ni, nj, nk);
+	if(small) {
+		small(C, nj, A, nk, B, nk, ni);
+		return;
+	}
+	gemm_rrc_blis_omp(userdata, C, A, B, ni, nj, nk);
+}
+
+void gemm_blas(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, dtype_t alpha, dtype_t* A, uint32_t lda, dtype_t* B, uint32_t ldb, dtype_t beta, dtype_t* C, uint32_t ldc) {
+	if(!ni || !nj) {
+		return;
+	}
+	// strides of op(A) along i and k and of op(B) along k and j: a row major
+	// operand that isn't transposed (or a column major one that is) is read
+	// along its rows
+	uint32_t rs_a = (layout == GEMM_ROW_MAJOR) != (trans_a == GEMM_TRANS) ? lda : 1;
+	uint32_t cs_a = rs_a == 1 ? lda : 1;
+	uint32_t rs_b = (layout == GEMM_ROW_MAJOR) != (trans_b == GEMM_TRANS) ? ldb : 1;
+	uint32_t cs_b = rs_b == 1 ? ldb : 1;
+	if(layout == GEMM_COL_MAJOR) {
+		// a column major C is the row major C^T = op(B)^T op(A)^T
+		uint32_t n = ni, rs = rs_a, cs = cs_a;
+		dtype_t* X = A;
+		ni = nj, nj = n;
+		A = B, rs_a = cs_b, cs_a = rs_b;
+		B = X, rs_b = cs, cs_b = rs;
+	}
+	GemmContext* ctx = userdata;
+	uint32_t n_threads = cpu_gemm_threads(ctx, ni, nj, nk);
+	if(!nk || alpha == 0) {
+		scale_c(C, ldc, ni, nj, beta);
+		return;
+	}
+	// dense operands in the layout of gemm_rrc keep all of its paths
+	if(alpha == 1 && ldc == nj && rs_a == nk && cs_a == 1 && rs_b == 1 && cs_b == nk) {
+		scale_c(C, ldc, ni, nj, beta);
+		gemm_rrc(userdata, C, A, B, ni, nj, nk);
+		return;
+	}
+	if(reproducible(ctx)) {
+		BlisTuning t = reproducible_tuning(ctx);
+		gemm_blis_strips(&BLIS_REPRODUCIBLE, ctx, &t, n_threads, C, NULL, ldc, A, rs_a, cs_a, B, rs_b, cs_b, alpha, beta, ni, nj, nk);
+		return;
+	}
+	const BlisTuning* t = &tuning_of(ctx)->blis[BLIS_BEST.tuning];
+	gemm_blis_strips(&BLIS_BEST, ctx, t, n_threads, C, NULL, ldc, A, rs_a, cs_a, B, rs_b, cs_b, alpha, beta, ni, nj, nk);
+}
+
+// with the KC and NC of the tuning at packing time
+GemmPackedB* gemm_pack_b(void* userdata, dtype_t* B, uint32_t nk, uint32_t nj, GemmLayout layout) {
+	const BlisTuning* t = &tuning_of(userdata)->blis[BLIS_BEST.tuning];
+	GemmPackedB* packed = cpu_packed_b_create(nk, nj, t->kc, t->nc, BLIS_BEST.nr);
+	if(!packed) {
+		return NULL;
+	}
+	// strides of B along k and j
+	pack_b_blocks(packed, B, layout == GEMM_ROW_MAJOR ? nj : 1, layout == GEMM_ROW_MAJOR ? 1 : nk);
+	return packed;
+}
+
+// C += A B straight from the KC x NR micro-panels of B, for a B packed with
+// another NR than the one of BLIS_BEST or when A couldn't be packed
+static void compute_unpacked(dtype_t* C, dtype_t* A, const GemmPackedB* B, uint32_t ni) {
+	uint32_t nj = B->nj, nk = B->nk, kc = B->kc, nc = B->nc, nr = B->nr;
+	for(uint32_t jc = 0; jc < nj; jc += nc) {
+		uint32_t J = MIN(nc, nj - jc);
+		for(uint32_t pc = 0; pc < nk; pc += kc) {
+			uint32_t K = MIN(kc, nk - pc);
+			const dtype_t* b = cpu_packed_b_block(B, pc, jc, J);
+			for(uint32_t j = 0; j < J; j++) {
+				const dtype_t* panel = &b[(size_t)(j / nr) * nr * K + j % nr];
+				for(uint32_t i = 0; i < ni; i++) {
+					dtype_t sum = 0;
+					for(uint32_t k = 0; k < K; k++) sum += A[(size_t)i * nk + pc + k] * panel[k * nr];
+					C[(size_t)i * nj + jc + j] += sum;
+				}
+			}
+		}
+	}
+}
+
+// gemm_compute for ni rows of A, packed into the workspace of the given thread
+static void compute_rows(GemmContext* ctx, const BlisTuning* t, uint32_t thread, dtype_t* C, dtype_t* A, const GemmPackedB* B, uint32_t ni) {
+	uint32_t nj = B->nj, nk = B->nk, kc = B->kc, nc = B->nc;
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(ctx, thread, t->mc * kc, 0, &scratch);
+	if(!ws) {
+		compute_unpacked(C, A, B, ni);
+		return;
+	}
+	for(uint32_t jc = 0; jc < nj; jc += nc) {
+		uint32_t J = MIN(nc, nj - jc);
+		for(uint32_t pc = 0; pc < nk; pc += kc) {
+			uint32_t K = MIN(kc, nk - pc);
+			blis_block(&BLIS_BEST, t, ws->block_a, cpu_packed_b_block(B, pc, jc, J), C, NULL, nj, A, nk, 1, ni, pc, jc, K, J);
+		}
+	}
+	cpu_workspace_release(ws, &scratch);
+}
+
+void gemm_compute(void* userdata, dtype_t* C, dtype_t* A, const GemmPackedB* B, uint32_t ni) {
+	// C is (ni, B->nj) row major
+	// A is (ni, B->nk) row major
+	if(!ni) {
+		return;
+	}
+	if(B->nr != BLIS_BEST.nr) {
+		compute_unpacked(C, A, B, ni);
+		return;
+	}
+	GemmContext* ctx = userdata;
+	const BlisTuning* t = &tuning_of(ctx)->blis[BLIS_BEST.tuning];
+	// every thread reads all of the packed B, so only A is cut, into row
+	// strips of whole MR tiles
+	GemmStrips strips = cpu_strips_along(1, ni, BLIS_BEST.mr, cpu_gemm_threads(ctx, ni, B->nj, B->nk));
+	#pragma omp parallel num_threads(strips.count)
+	{
+		uint32_t thread = omp_get_thread_num(), size;
+		uint32_t begin = cpu_strip(&strips, thread, &size);
+		if(size) {
+			compute_rows(ctx, t, thread, &C[(size_t)begin * B->nj], &A[(size_t)begin * B->nk], B, size);
+		}
+	}
+}
+
+#ifdef HAVE_AVX2
+#define TILE_ROW_AVX(r) \
+	a_scalar = _mm256_broadcast_ss(&A[(ii + r) * tile + ik]); \
+	c##r##0 = _mm256_fmadd_ps(a_scalar, b0, c##r##0); \
+	c##r##1 = _mm256_fmadd_ps(a_scalar, b1, c##r##1);
+
+#define LOAD_TILE_ROW_AVX(r) \
+	__m256 c##r##0 = _mm256_load_ps(&C[(ii + r) * tile + ij]); \
+	__m256 c##r##1 = _mm256_load_ps(&C[(ii + r) * tile + ij + 8]);
+
+#define STORE_TILE_ROW_AVX(r) \
+	_mm256_store_ps(&C[(ii + r) * tile + ij], c##r##0); \
+	_mm256_store_ps(&C[(ii + r) * tile + ij + 8], c##r##1);
+#endif
+
+#define TILE_STEP_AVX(rows) \
+	for(uint32_t ik = 0; ik < K; ik++) { \
+		__m256 b0 = _mm256_load_ps(&B[ik * tile + ij]); \
+		__m256 b1 = _mm256_load_ps(&B[ik * tile + ij + 8]); \
+		__m256 a_scalar; \
+		rows \
+	}
+
+// C += A B for row major tile x tile tiles, of which only the first I rows of
+// A, J columns of B and K columns of A / rows of B can be non-zero. I and J are
+// rounded up to the register tiles (6x16, then 2x16 for the last rows), which
+// the zero padding makes free
+static void tile_multiply(dtype_t* C, const dtype_t* A, const dtype_t* B, uint32_t tile, uint32_t I, uint32_t J, uint32_t K) {
+	I = ALIGN_UP(I, 2);
+	J = ALIGN_UP(J, 16);
+#ifdef HAVE_AVX2
+	for(uint32_t ij = 0; ij < J; ij += 16) {
+		uint32_t ii = 0;
+		for(; ii + 6 <= I; ii += 6) {
+			LOAD_TILE_ROW_AVX(0) LOAD_TILE_ROW_AVX(1) LOAD_TILE_ROW_AVX(2)
+			LOAD_TILE_ROW_AVX(3) LOAD_TILE_ROW_AVX(4) LOAD_TILE_ROW_AVX(5)
+			TILE_STEP_AVX(TILE_ROW_AVX(0) TILE_ROW_AVX(1) TILE_ROW_AVX(2) TILE_ROW_AVX(3) TILE_ROW_AVX(4) TILE_ROW_AVX(5))
+			STORE_TILE_ROW_AVX(0) STORE_TILE_ROW_AVX(1) STORE_TILE_ROW_AVX(2)
+			STORE_TILE_ROW_AVX(3) STORE_TILE_ROW_AVX(4) STORE_TILE_ROW_AVX(5)
+		}
+		for(; ii < I; ii += 2) {
+			LOAD_TILE_ROW_AVX(0) LOAD_TILE_ROW_AVX(1)
+			TILE_STEP_AVX(TILE_ROW_AVX(0) TILE_ROW_AVX(1))
+			STORE_TILE_ROW_AVX(0) STORE_TILE_ROW_AVX(1)
+		}
+	}
+#else
+	for(uint32_t ii = 0; ii < I; ii++) {
+		for(uint32_t ik = 0; ik < K; ik++) {
+			dtype_t a = A[ii * tile + ik];
+			for(uint32_t ij = 0; ij < J; ij++) C[ii * tile + ij] += a * B[ik * tile + ij];
+		}
+	}
+#endif
+}
+
+// one C tile per iteration, in Ct when C is tiled or else in a zeroed scratch
+// tile that is added to the row major C at the end
+static void gemm_tiled(GemmContext* ctx, TiledMatrix* Ct, dtype_t* C, const TiledMatrix* A, const TiledMatrix* B) {
+	uint32_t tile = A->tile;
+	uint32_t ni = A->rows, nj = B->cols, nk = A->cols;
+	uint32_t tiles_i = A->tile_rows, tiles_j = B->tile_cols, tiles_k = A->tile_cols;
+	#pragma omp parallel num_threads(ctx ? ctx->n_threads : (uint32_t)omp_get_max_threads())
+	{
+		GemmWorkspace scratch;
+		GemmWorkspace* ws = Ct ? NULL : cpu_workspace_acquire(ctx, omp_get_thread_num(), tile * tile, 0, &scratch);
+		#pragma omp for collapse(2) schedule(dynamic)
+		for(uint32_t ti = 0; ti < tiles_i; ti++) {
+			for(uint32_t tj = 0; tj < tiles_j; tj++) {
+				uint32_t I = MIN(tile, ni - ti * tile);
+				uint32_t J = MIN(tile, nj - tj * tile);
+				if(!Ct && !ws) {
+					// out of memory: straight into C
+					for(uint32_t tk = 0; tk < tiles_k; tk++) {
+						const dtype_t* a = cpu_tiled_tile(A, ti, tk);
+						const dtype_t* b = cpu_tiled_tile(B, tk, tj);
+						for(uint32_t ii = 0; ii < I; ii++) {
+							for(uint32_t ik = 0; ik < MIN(tile, nk - tk * tile); ik++) {
+								for(uint32_t ij = 0; ij < J; ij++) C[(ti * tile + ii) * nj + tj * tile + ij] += a[ii * tile + ik] * b[ik * tile + ij];
+							}
+						}
+					}
+					continue;
+				}
+				dtype_t* c = Ct ? cpu_tiled_tile(Ct, ti, tj) : ws->block_a;
+				if(!Ct) {
+					memset(c, 0x00, tile * tile * sizeof(dtype_t));
+				}
+				for(uint32_t tk = 0; tk < tiles_k; tk++) {
+					tile_multiply(c, cpu_tiled_tile(A, ti, tk), cpu_tiled_tile(B, tk, tj), tile, I, J, MIN(tile, nk - tk * tile));
+				}
+				if(!Ct) {
+					for(uint32_t ii = 0; ii < I; ii++) {
+						for(uint32_t ij = 0; ij < J; ij++) C[(ti * tile + ii) * nj + tj * tile + ij] += c[ii * tile + ij];
+					}
+				}
+			}
+		}
+		if(ws) {
+			cpu_workspace_release(ws, &scratch);
+		}
+	}
+}
+
+void gemm_ttt_tiled(void* userdata, TiledMatrix* C, const TiledMatrix* A, const TiledMatrix* B) {
+	gemm_tiled(userdata, C, NULL, A, B);
+}
+
+void gemm_rtt_tiled(void* userdata, dtype_t* C, const TiledMatrix* A, const TiledMatrix* B) {
+	gemm_tiled(userdata, NULL, C, A, B);
 }
@@ -0,0 +1,294 @@
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <immintrin.h>
+#include "cpu/cpu_gemm.h"
+#include "cpu/cpu_cache.h"
+#include "cpu/cpu_context.h"
+
+// the int8 GEMM: u8 A times s8 B with int32 accumulators, requantized by the
+// epilogue of the last KC block. Like cpu_gemm.c this file is compiled once per
+// instruction set (see ISA_SRC in the Makefile). Its AVX-512 build also uses
+// AVX512-VNNI and the dispatch binds the AVX2 build instead on hosts without it
+#ifndef GEMM_SCALAR
+#if defined(__SSE2__)
+#define HAVE_SSE2
+#endif
+#if defined(__AVX2__)
+#define HAVE_AVX2
+#endif
+#if defined(__AVX512VNNI__)
+#define HAVE_AVX512_VNNI
+#endif
+#endif
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+
+// the packed panels hold groups of KG consecutive k of each line, the products
+// of one group are summed into one int32 lane:
+// - vpdpbusd multiplies 4 u8 by 4 s8 and adds them to the lane, without
+//   intermediate saturation
+// - without VNNI the bytes are widened to int16 while packing and vpmaddwd adds
+//   pairs of products. vpmaddubsw would read the bytes directly, but saturates
+//   the sum of two products to int16 (2 x 255 x 127 does not fit), so every ISA
+//   gives the exact int32 result
+// The register tile is MR rows of NV vectors of VLEN int32 columns
+#if defined(HAVE_AVX512_VNNI)
+#define KG 4
+#define PACKED uint8_t // the s8 of B keep their bits
+#define VEC __m512i
+#define VLEN 16
+#define VZERO() _mm512_setzero_si512()
+#define VLOAD(p) _mm512_loadu_si512(p)
+#define VSTORE(p, v) _mm512_storeu_si512(p, v)
+#define VBROADCAST(p) _mm512_set1_epi32(load_group(p))
+#define VDOT(acc, a, b) _mm512_dpbusd_epi32(acc, a, b)
+#define MR 14
+#define NV 2
+#elif defined(HAVE_AVX2)
+#define KG 2
+#define PACKED int16_t
+#define VEC __m256i
+#define VLEN 8
+#define VZERO() _mm256_setzero_si256()
+#define VLOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define VSTORE(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+#define VBROADCAST(p) _mm256_set1_epi32(load_group(p))
+#define VDOT(acc, a, b) _mm256_add_epi32(acc, _mm256_madd_epi16(a, b))
+#define MR 6
+#define NV 2
+#elif defined(HAVE_SSE2)
+#define KG 2
+#define PACKED int16_t
+#define VEC __m128i
+#define VLEN 4
+#define VZERO() _mm_setzero_si128()
+#define VLOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define VSTORE(p, v) _mm_storeu_si128((__m128i*)(p), v)
+#define VBROADCAST(p) _mm_set1_epi32(load_group(p))
+#define VDOT(acc, a, b) _mm_add_epi32(acc, _mm_madd_epi16(a, b))
+#define MR 6
+#define NV 2
+#else
+#define KG 1
+#define PACKED int16_t
+#define VEC int32_t
+#define VLEN 1
+#define VZERO() 0
+#define VLOAD(p) (*(p))
+#define VSTORE(p, v) (*(p) = (v))
+#define VBROADCAST(p) (*(p))
+#define VDOT(acc, a, b) ((acc) + (a) * (b))
+#define MR 4
+#define NV 8
+#endif
+#define NR (NV * VLEN)
+
+#if KG > 1
+// the KG values of a group as one int32, to broadcast it
+static inline int32_t load_group(const PACKED* p) {
+	int32_t group;
+	memcpy(&group, p, sizeof(group));
+	return group;
+}
+#endif
+
+// MC/KC/NC of the analytical model for the tile and the packed element, with
+// KC in whole groups. Set by a load-time constructor
+static BlisBlocking int8_blocking;
+
+__attribute__((constructor)) static void init_int8_blocking(void) {
+	BlisBlocking b = cpu_blis_blocking(MR, NR, sizeof(PACKED));
+	b.mc = MAX(MR, b.mc / MR * MR);
+	b.kc = MAX(KG, b.kc / KG * KG);
+	b.nc = MAX(NR, b.nc / NR * NR);
+	int8_blocking = b;
+}
+
+// pack n lines of length k (line x at src[x * ld], contiguous along k) into
+// w-line micro-panels of KG-value groups, group g of line x at
+// dst[(g * w + x) * KG], zero-padded to whole groups and panels. The sum of
+// each line is added to sums[x] on the way, for the zero point corrections
+static void pack_panels(PACKED* dst, const uint8_t* src, size_t ld, uint32_t n, uint32_t k, uint32_t w, int is_signed, int32_t* sums) {
+	uint32_t groups = (k + KG - 1) / KG;
+	for(uint32_t x = 0; x < n; x += w) {
+		uint32_t R = MIN(w, n - x);
+		for(uint32_t ix = 0; ix < R; ix++) {
+			const uint8_t* s = &src[(size_t)(x + ix) * ld];
+			int32_t sum = 0;
+			for(uint32_t ik = 0; ik < k; ik++) {
+				int32_t v = is_signed ? (int8_t)s[ik] : s[ik];
+				dst[(ik / KG * w + ix) * KG + ik % KG] = (PACKED)v;
+				sum += v;
+			}
+			for(uint32_t ik = k; ik < groups * KG; ik++) dst[(ik / KG * w + ix) * KG + ik % KG] = 0;
+			sums[x + ix] += sum;
+		}
+		for(uint32_t g = 0; R < w && g < groups; g++) memset(&dst[(g * w + R) * KG], 0, (w - R) * KG * sizeof(PACKED));
+		dst += (size_t)groups * w * KG;
+	}
+}
+
+// the int32 MR x NR tile of the micro-panels a and b, over the given number of
+// groups, stored to tile
+static void micro_kernel(uint32_t groups, const PACKED* a, const PACKED* b, int32_t* tile) {
+	VEC acc[MR][NV];
+	_Pragma("GCC unroll 16")
+	for(uint32_t i = 0; i < MR; i++) {
+		_Pragma("GCC unroll 8")
+		for(uint32_t v = 0; v < NV; v++) acc[i][v] = VZERO();
+	}
+	for(uint32_t g = 0; g < groups; g++) {
+		VEC bv[NV];
+		_Pragma("GCC unroll 8")
+		for(uint32_t v = 0; v < NV; v++) bv[v] = VLOAD(&b[v * VLEN * KG]);
+		_Pragma("GCC unroll 16")
+		for(uint32_t i = 0; i < MR; i++) {
+			VEC ai = VBROADCAST(&a[i * KG]);
+			_Pragma("GCC unroll 8")
+			for(uint32_t v = 0; v < NV; v++) acc[i][v] = VDOT(acc[i][v], ai, bv[v]);
+		}
+		a += MR * KG;
+		b += NR * KG;
+	}
+	_Pragma("GCC unroll 16")
+	for(uint32_t i = 0; i < MR; i++) {
+		_Pragma("GCC unroll 8")
+		for(uint32_t v = 0; v < NV; v++) VSTORE(&tile[i * NR + v * VLEN], acc[i][v]);
+	}
+}
+
+// C (m, n) from the int32 tile: with s_a and s_b the sums of the rows of A and
+// the columns of B, sum (A - za)(B - zb) = tile - zb s_a - za s_b + nk za zb.
+// Then scaled, offset by the bias and stored as float (Cf) or saturated to int8
+// (Cs). The int32 arithmetic wraps, so only the result has to fit
+static void requantize(const int32_t* tile, uint32_t m, uint32_t n, const int32_t* sum_a, const int32_t* sum_b, uint32_t nk, const GemmQuantization* q, uint32_t j0, float* Cf, int8_t* Cs, uint32_t ldc) {
+	uint32_t zero_a = (uint32_t)q->zero_a;
+	uint32_t zero_b[NR], column[NR];
+	float scale[NR], bias[NR];
+	for(uint32_t j = 0; j < n; j++) {
+		uint32_t c = q->per_channel ? j0 + j : 0;
+		zero_b[j] = q->zero_b ? (uint32_t)q->zero_b[c] : 0;
+		scale[j] = q->scale[c];
+		bias[j] = q->bias ? q->bias[c] : 0;
+		column[j] = zero_a * (uint32_t)sum_b[j] - nk * zero_a * zero_b[j];
+	}
+	for(uint32_t i = 0; i < m; i++) {
+		for(uint32_t j = 0; j < n; j++) {
+			int32_t acc = (int32_t)((uint32_t)tile[i * NR + j] - zero_b[j] * (uint32_t)sum_a[i] - column[j]);
+			float real = scale[j] * (float)acc + bias[j];
+			if(Cf) {
+				Cf[(size_t)i * ldc + j] = real;
+			} else {
+				float r = nearbyintf(real / q->scale_c) + (float)q->zero_c;
+				Cs[(size_t)i * ldc + j] = (int8_t)(r < -128 ? -128 : r > 127 ? 127 : r);
+			}
+		}
+	}
+}
+
+// C (m, n) = the requantized A (m, nk) B (nk, n), A row major and B column
+// major. j0 is the column of C the per-channel parameters start at. Besides the
+// packed panels, the workspace holds the row sums of A after its panels, and
+// the column sums of B and the int32 partial C of the KC blocks but the last
+// after the panels of B
+static void gemm_int8_strip(GemmContext* ctx, uint32_t thread, uint32_t m, uint32_t n, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, uint32_t j0, float* Cf, int8_t* Cs, uint32_t ldc) {
+	uint32_t mc = int8_blocking.mc, kc = int8_blocking.kc, nc = int8_blocking.nc;
+	size_t panels_a = (size_t)mc * kc * sizeof(PACKED), panels_b = (size_t)kc * nc * sizeof(PACKED);
+	size_t partial = nk > kc ? (size_t)m * n : 0;
+	// the workspaces count dtype_t elements
+	size_t size_a = (panels_a + m * sizeof(int32_t) + sizeof(dtype_t) - 1) / sizeof(dtype_t);
+	size_t size_b = (panels_b + (nc + partial) * sizeof(int32_t) + sizeof(dtype_t) - 1) / sizeof(dtype_t);
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(ctx, thread, size_a, size_b, &scratch);
+	if(!ws) {
+		// out of memory: one element at a time, through the same epilogue
+		for(uint32_t i = 0; i < m; i++) {
+			for(uint32_t j = 0; j < n; j++) {
+				uint32_t acc = 0;
+				int32_t row = 0, column = 0;
+				for(uint32_t k = 0; k < nk; k++) {
+					acc += (uint32_t)(A[(size_t)i * lda + k] * B[(size_t)j * ldb + k]);
+					row += A[(size_t)i * lda + k];
+					column += B[(size_t)j * ldb + k];
+				}
+				int32_t tile = (int32_t)acc;
+				size_t c = (size_t)i * ldc + j;
+				requantize(&tile, 1, 1, &row, &column, nk, q, j0 + j, Cf ? &Cf[c] : NULL, Cs ? &Cs[c] : NULL, ldc);
+			}
+		}
+		return;
+	}
+	PACKED* block_a = (PACKED*)ws->block_a;
+	PACKED* block_b = (PACKED*)ws->block_b;
+	int32_t* sum_a = (int32_t*)((char*)ws->block_a + panels_a);
+	int32_t* sum_b = (int32_t*)((char*)ws->block_b + panels_b);
+	int32_t* P = sum_b + nc;
+	int32_t tile[MR * NR];
+	for(uint32_t jc = 0; jc < n; jc += nc) {
+		uint32_t J = MIN(nc, n - jc);
+		// nk == 0 still runs one empty block for the epilogue
+		for(uint32_t pc = 0; pc == 0 || pc < nk; pc += kc) {
+			uint32_t K = MIN(kc, nk - pc), groups = (K + KG - 1) / KG;
+			int last = pc + K >= nk;
+			if(!pc) {
+				memset(sum_a, 0, m * sizeof(int32_t));
+				memset(sum_b, 0, J * sizeof(int32_t));
+			}
+			// --- Pack B block into KC x NR micro-panels ---
+			pack_panels(block_b, (const uint8_t*)&B[(size_t)jc * ldb + pc], ldb, J, K, NR, 1, sum_b);
+			for(uint32_t ic = 0; ic < m; ic += mc) {
+				uint32_t I = MIN(mc, m - ic);
+				// --- Pack A block into MR x KC micro-panels ---
+				pack_panels(block_a, &A[(size_t)ic * lda + pc], lda, I, K, MR, 0, &sum_a[ic]);
+				for(uint32_t jr = 0; jr < J; jr += NR) {
+					for(uint32_t ir = 0; ir < I; ir += MR) {
+						uint32_t rows = MIN(MR, I - ir), columns = MIN(NR, J - jr);
+						micro_kernel(groups, &block_a[(size_t)ir * groups * KG], &block_b[(size_t)jr * groups * KG], tile);
+						int32_t* p = &P[(size_t)(ic + ir) * n + jc + jr];
+						for(uint32_t i = 0; pc && i < rows; i++) {
+							for(uint32_t j = 0; j < columns; j++) tile[i * NR + j] += p[(size_t)i * n + j];
+						}
+						if(!last) {
+							for(uint32_t i = 0; i < rows; i++) memcpy(&p[(size_t)i * n], &tile[i * NR], columns * sizeof(int32_t));
+							continue;
+						}
+						size_t c = (size_t)(ic + ir) * ldc + jc + jr;
+						requantize(tile, rows, columns, &sum_a[ic + ir], &sum_b[jr], nk, q, j0 + jc + jr, Cf ? &Cf[c] : NULL, Cs ? &Cs[c] : NULL, ldc);
+					}
+				}
+			}
+		}
+	}
+	cpu_workspace_release(ws, &scratch);
+}
+
+// one strip of C per thread along its longer side (see cpu_strips)
+static void gemm_int8(void* userdata, uint32_t ni, uint32_t nj, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, float* Cf, int8_t* Cs, uint32_t ldc) {
+	if(!ni || !nj) {
+		return;
+	}
+	GemmContext* ctx = userdata;
+	GemmStrips strips = cpu_strips(ni, nj, MR, NR, cpu_gemm_threads(ctx, ni, nj, nk));
+	#pragma omp parallel num_threads(strips.count)
+	{
+		uint32_t thread = omp_get_thread_num(), size;
+		uint32_t begin = cpu_strip(&strips, thread, &size);
+		size_t c = strips.by_rows ? (size_t)begin * ldc : begin;
+		if(size && strips.by_rows) {
+			gemm_int8_strip(ctx, thread, size, nj, nk, &A[(size_t)begin * lda], lda, B, ldb, q, 0, Cf ? &Cf[c] : NULL, Cs ? &Cs[c] : NULL, ldc);
+		} else if(size) {
+			gemm_int8_strip(ctx, thread, ni, size, nk, A, lda, &B[(size_t)begin * ldb], ldb, q, begin, Cf ? &Cf[c] : NULL, Cs ? &Cs[c] : NULL, ldc);
+		}
+	}
+}
+
+void gemm_rrc_u8s8_f32(void* userdata, uint32_t ni, uint32_t nj, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, float* C, uint32_t ldc) {
+	gemm_int8(userdata, ni, nj, nk, A, lda, B, ldb, q, C, NULL, ldc);
+}
+
+void gemm_rrc_u8s8_s8(void* userdata, uint32_t ni, uint32_t nj, uint32_t nk, const uint8_t* A, uint32_t lda, const int8_t* B, uint32_t ldb, const GemmQuantization* q, int8_t* C, uint32_t ldc) {
+	gemm_int8(userdata, ni, nj, nk, A, lda, B, ldb, q, NULL, C, ldc);
+}
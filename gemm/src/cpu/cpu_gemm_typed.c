@@ -0,0 +1,49 @@
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <immintrin.h>
+#include "cpu/cpu_gemm.h"
+#include "cpu/cpu_cache.h"
+#include "cpu/cpu_context.h"
+
+// the type-generic BLIS family: cpu_gemm_typed.h instantiated once per type
+// with its generic micro-kernel, for gemm_blas_f64, gemm_blas_bf16 and
+// gemm_blas_f16 (fp32 is dtype_t, whose instantiation is in cpu_gemm.c with
+// the hand-tuned micro-kernels). Like
+// cpu_gemm.c this file is compiled once per instruction set (see ISA_SRC in the
+// Makefile) and bound at load time
+#ifndef GEMM_SCALAR
+#if defined(__SSE2__)
+#define HAVE_SSE2
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+#define HAVE_AVX2
+#endif
+#if defined(__AVX512F__)
+#define HAVE_AVX512
+#endif
+#if defined(__F16C__)
+#define HAVE_F16C
+#endif
+#endif
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#define ALIGN_UP(x, n) (((x) + (n) - 1) / (n) * (n))
+
+// largest register tile of the generic micro-kernel (AVX-512)
+#define MR_MAX 14
+#define NR_MAX 32
+
+#define GEMM_TYPE GEMM_TYPE_F64
+#include "cpu_gemm_typed.h"
+#undef GEMM_TYPE
+
+#define GEMM_TYPE GEMM_TYPE_BF16
+#include "cpu_gemm_typed.h"
+#undef GEMM_TYPE
+
+#define GEMM_TYPE GEMM_TYPE_F16
+#include "cpu_gemm_typed.h"
+#undef GEMM_TYPE
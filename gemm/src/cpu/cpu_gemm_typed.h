@@ -0,0 +1,539 @@
+// body of the BLIS family, included once per type with GEMM_TYPE set: by
+// cpu_gemm.c for fp32, whose hand-tuned micro-kernels plug into the driver
+// below, and by cpu_gemm_typed.c for the other types, which also get the
+// generic micro-kernel and gemm_blas entry point at the end. Everything defined
+// here is named through TYPED (the fp32 names are the plain ones), and every
+// per-type macro is undefined at the end for the next instantiation. REAL is
+// the type of C and of the arithmetic, INPUT the one A and B are stored in,
+// which TO_REAL widens while they are packed. The includer defines MR_MAX and
+// NR_MAX, the largest register tile of its micro-kernels
+
+#ifndef CPU_GEMM_TYPED_H
+#define CPU_GEMM_TYPED_H
+
+// one instantiation per type, another type needs its branch of the macros
+// below and its declaration in cpu/cpu_gemm.h
+#define GEMM_TYPE_F32 0
+#define GEMM_TYPE_F64 1
+#define GEMM_TYPE_BF16 2 // bf16 A and B, fp32 C and arithmetic
+#define GEMM_TYPE_F16 3 // same with fp16
+
+// unroll factors 1, 2 and 4 to 0, 1 and 2
+#define UNROLL_INDEX(unroll) ((unroll) >> 1)
+
+#endif
+
+#if GEMM_TYPE == GEMM_TYPE_F32
+#define REAL dtype_t
+#define INPUT dtype_t
+#define TO_REAL(x) (x)
+#define ABS(x) fabsf(x)
+#define TYPED(name) name
+#elif GEMM_TYPE == GEMM_TYPE_F64
+#define REAL double
+#define INPUT double
+#define TO_REAL(x) (x)
+#define ABS(x) fabs(x)
+#define TYPED(name) name##_f64
+#elif GEMM_TYPE == GEMM_TYPE_BF16
+#define REAL float
+#define INPUT bf16_t
+#define TO_REAL(x) cpu_bf16_to_f32(x)
+#define ABS(x) fabsf(x)
+#define TYPED(name) name##_bf16
+#elif GEMM_TYPE == GEMM_TYPE_F16
+#define REAL float
+#define INPUT f16_t
+#ifdef HAVE_F16C
+#define TO_REAL(x) _cvtsh_ss(x)
+#else
+#define TO_REAL(x) cpu_f16_to_f32(x)
+#endif
+#define ABS(x) fabsf(x)
+#define TYPED(name) name##_f16
+#else
+#error "GEMM_TYPE has no instantiation"
+#endif
+
+// C (m, n) += the k x MR micro-panel a times the k x NR micro-panel b, for any
+// m <= MR and n <= NR
+typedef void (*TYPED(MicroKernel))(uint32_t k, REAL* a, REAL* b, REAL* C, uint32_t ldc, uint32_t m, uint32_t n);
+
+// BLIS-style blocking: MR x NR is the register tile of the micro-kernel,
+// KC x NR B micro-panels stay in L1, MC x KC A blocks in L2 and KC x NC B
+// blocks in L3. MC/KC/NC, the loop order around the micro-kernel and the
+// unroll factor of its k loop come from the BlisTuning of every call
+typedef struct {
+	TYPED(MicroKernel) kernel[3]; // indexed by UNROLL_INDEX(unroll)
+	TYPED(MicroKernel) edge[3]; // for the tiles at most edge_nr columns wide
+	uint32_t mr;
+	uint32_t nr;
+	uint32_t edge_nr;
+	int tuning; // index in GemmTuning.blis, -1 for the analytical blocking only
+} TYPED(BlisConfig);
+
+// pack n lines of length k (line x, position ik at src[x * xs + ik * ks]),
+// widened to REAL, into w-line micro-panels, each stored k-major (w contiguous
+// values per k) and the last one zero-padded. In fp32, lines contiguous along k
+// are transposed in tiles and lines contiguous along x copied one k at a time
+static void TYPED(pack_panels)(REAL* dst, INPUT* src, uint32_t xs, uint32_t ks, uint32_t n, uint32_t k, uint32_t w) {
+	for(uint32_t x = 0; x < n; x += w) {
+		uint32_t R = MIN(w, n - x);
+		INPUT* s = &src[(size_t)x * xs];
+#if GEMM_TYPE == GEMM_TYPE_F32
+		if(ks == 1) {
+			transpose_block(dst, w, s, xs, R, k);
+		} else if(xs == 1) {
+			for(uint32_t ik = 0; ik < k; ik++) memcpy(&dst[ik * w], &s[(size_t)ik * ks], R * sizeof(REAL));
+		} else {
+			for(uint32_t ik = 0; ik < k; ik++) {
+				for(uint32_t ix = 0; ix < R; ix++) dst[ik * w + ix] = s[(size_t)ix * xs + (size_t)ik * ks];
+			}
+		}
+#else
+		// the inner loop runs along whichever of x and k is contiguous
+		if(ks == 1) {
+			for(uint32_t ix = 0; ix < R; ix++) {
+				for(uint32_t ik = 0; ik < k; ik++) dst[ik * w + ix] = TO_REAL(s[(size_t)ix * xs + ik]);
+			}
+		} else {
+			for(uint32_t ik = 0; ik < k; ik++) {
+				for(uint32_t ix = 0; ix < R; ix++) dst[ik * w + ix] = TO_REAL(s[(size_t)ix * xs + (size_t)ik * ks]);
+			}
+		}
+#endif
+		if(R < w) {
+			for(uint32_t ik = 0; ik < k; ik++) memset(&dst[ik * w + R], 0x00, (w - R) * sizeof(REAL));
+		}
+		dst += (size_t)w * k;
+	}
+}
+
+// pack a (m, k) block of A with strides rs/cs into mr-row micro-panels
+static void TYPED(pack_a_panels)(REAL* dst, INPUT* A, uint32_t rs, uint32_t cs, uint32_t m, uint32_t k, uint32_t mr) {
+	TYPED(pack_panels)(dst, A, rs, cs, m, k, mr);
+}
+
+// pack a (k, n) block of B with strides rs/cs into nr-column micro-panels
+static void TYPED(pack_b_panels)(REAL* dst, INPUT* B, uint32_t rs, uint32_t cs, uint32_t k, uint32_t n, uint32_t nr) {
+	TYPED(pack_panels)(dst, B, cs, rs, n, k, nr);
+}
+
+// C += T for a (m, n) tile with Neumaier's compensation: the rounding error of
+// every addition is accumulated into E (same strides as C), for the caller to
+// add to C once at the end
+static void TYPED(compensated_add)(REAL* C, REAL* E, uint32_t ldc, const REAL* T, uint32_t ldt, uint32_t m, uint32_t n) {
+	for(uint32_t i = 0; i < m; i++) {
+		REAL* c = &C[(size_t)i * ldc], *e = &E[(size_t)i * ldc];
+		const REAL* x = &T[(size_t)i * ldt];
+		uint32_t j = 0;
+#if GEMM_TYPE == GEMM_TYPE_F32 && defined(HAVE_AVX2)
+		__m256 sign = _mm256_set1_ps(-0.0f);
+		for(; j < n; j += 8) {
+			__m256i mask = mask_avx(n - j);
+			__m256 a = _mm256_maskload_ps(&c[j], mask), b = _mm256_maskload_ps(&x[j], mask);
+			__m256 sum = _mm256_add_ps(a, b);
+			__m256 a_larger = _mm256_cmp_ps(_mm256_andnot_ps(sign, a), _mm256_andnot_ps(sign, b), _CMP_GE_OQ);
+			__m256 larger = _mm256_blendv_ps(b, a, a_larger), smaller = _mm256_blendv_ps(a, b, a_larger);
+			__m256 error = _mm256_add_ps(_mm256_sub_ps(larger, sum), smaller);
+			_mm256_maskstore_ps(&c[j], mask, sum);
+			_mm256_maskstore_ps(&e[j], mask, _mm256_add_ps(_mm256_maskload_ps(&e[j], mask), error));
+		}
+#endif
+		for(; j < n; j++) {
+			REAL a = c[j], b = x[j], sum = a + b;
+			e[j] += ABS(a) >= ABS(b) ? (a - sum) + b : (b - sum) + a;
+			c[j] = sum;
+		}
+	}
+}
+
+// one micro-kernel call: straight into C, or with E into a zeroed tile that is
+// then added to C with compensation
+static inline void TYPED(blis_tile)(TYPED(MicroKernel) f, uint32_t K, REAL* a, REAL* b, REAL* C, REAL* E, uint32_t ldc, uint32_t m, uint32_t n) {
+	if(!E) {
+		f(K, a, b, C, ldc, m, n);
+		return;
+	}
+	REAL tile[MR_MAX * NR_MAX];
+	memset(tile, 0, m * NR_MAX * sizeof(REAL));
+	f(K, a, b, tile, NR_MAX, m, n);
+	TYPED(compensated_add)(C, E, ldc, tile, NR_MAX, m, n);
+}
+
+// the jr/ir loops around the micro-kernel, for a packed I x K block of A and
+// K x J block of B updating the (I, J) block of C at C. E, when not NULL, holds
+// the compensation terms of C (see compensated_add)
+static void TYPED(blis_macro_kernel)(const TYPED(BlisConfig)* cfg, const BlisTuning* t, REAL* block_a, REAL* block_b, REAL* C, REAL* E, uint32_t ldc, uint32_t I, uint32_t K, uint32_t J) {
+	uint32_t mr = cfg->mr, nr = cfg->nr;
+	TYPED(MicroKernel) kernel = cfg->kernel[UNROLL_INDEX(t->unroll)];
+	TYPED(MicroKernel) edge = cfg->edge[UNROLL_INDEX(t->unroll)];
+	if(t->order == LOOP_ORDER_JR_IR) {
+		for(uint32_t jr = 0; jr < J; jr += nr) {
+			TYPED(MicroKernel) f = J - jr <= cfg->edge_nr ? edge : kernel;
+			for(uint32_t ir = 0; ir < I; ir += mr) {
+				TYPED(blis_tile)(f, K, &block_a[ir * K], &block_b[jr * K], &C[ir * ldc + jr], E ? &E[ir * ldc + jr] : NULL, ldc, MIN(mr, I - ir), MIN(nr, J - jr));
+			}
+		}
+	} else {
+		for(uint32_t ir = 0; ir < I; ir += mr) {
+			for(uint32_t jr = 0; jr < J; jr += nr) {
+				TYPED(MicroKernel) f = J - jr <= cfg->edge_nr ? edge : kernel;
+				TYPED(blis_tile)(f, K, &block_a[ir * K], &block_b[jr * K], &C[ir * ldc + jr], E ? &E[ir * ldc + jr] : NULL, ldc, MIN(mr, I - ir), MIN(nr, J - jr));
+			}
+		}
+	}
+}
+
+// the loops inside a packed K x J block of B (at pc, jc): ic, packing A, and
+// the macro kernel. ldc is the row stride of C (and E), rs_a and cs_a the row
+// and column strides of A
+static void TYPED(blis_block)(const TYPED(BlisConfig)* cfg, const BlisTuning* t, REAL* block_a, REAL* block_b, REAL* C, REAL* E, uint32_t ldc, INPUT* A, uint32_t rs_a, uint32_t cs_a, uint32_t ni, uint32_t pc, uint32_t jc, uint32_t K, uint32_t J) {
+	uint32_t mc = t->mc;
+	for(uint32_t ic = 0; ic < ni; ic += mc) {
+		uint32_t I = MIN(mc, ni - ic);
+		// --- Pack A block into MR x KC micro-panels ---
+		TYPED(pack_a_panels)(block_a, &A[(size_t)ic * rs_a + (size_t)pc * cs_a], rs_a, cs_a, I, K, cfg->mr);
+		TYPED(blis_macro_kernel)(cfg, t, block_a, block_b, &C[ic * ldc + jc], E ? &E[ic * ldc + jc] : NULL, ldc, I, K, J);
+	}
+}
+
+// x *= alpha for the n values of a packed block (the padding stays zero)
+static void TYPED(scale_packed)(REAL* x, size_t n, REAL alpha) {
+	if(alpha == 1) {
+		return;
+	}
+	for(size_t i = 0; i < n; i++) x[i] *= alpha;
+}
+
+// C += alpha A B straight from the operands, strides as in gemm_blis_strided,
+// for when the packing buffers couldn't be allocated
+static void TYPED(gemm_unpacked)(REAL* C, uint32_t ldc, INPUT* A, uint32_t rs_a, uint32_t cs_a, INPUT* B, uint32_t rs_b, uint32_t cs_b, REAL alpha, uint32_t ni, uint32_t nj, uint32_t nk) {
+	for(uint32_t i = 0; i < ni; i++) {
+		for(uint32_t j = 0; j < nj; j++) {
+			REAL sum = 0;
+			for(uint32_t k = 0; k < nk; k++) sum += TO_REAL(A[(size_t)i * rs_a + (size_t)k * cs_a]) * TO_REAL(B[(size_t)k * rs_b + (size_t)j * cs_b]);
+			C[(size_t)i * ldc + j] += alpha * sum;
+		}
+	}
+}
+
+// C += alpha A B on views with any strides, with the block sizes of t: ldc is
+// the row stride of C (and E), rs_a/cs_a the strides of A along i and k and
+// rs_b/cs_b those of B along k and j. Packing absorbs the layouts (and alpha,
+// into the blocks of B). Packs into the workspace of the given thread of the
+// context and never goes through the pack cache. With E the panels are added
+// with compensation
+static void TYPED(gemm_blis_strided)(const TYPED(BlisConfig)* cfg, GemmContext* ctx, const BlisTuning* t, uint32_t thread, REAL* C, REAL* E, uint32_t ldc, INPUT* A, uint32_t rs_a, uint32_t cs_a, INPUT* B, uint32_t rs_b, uint32_t cs_b, REAL alpha, uint32_t ni, uint32_t nj, uint32_t nk) {
+	uint32_t mc = t->mc, kc = t->kc, nc = t->nc;
+	// the workspaces count dtype_t elements
+	size_t scale = (sizeof(REAL) + sizeof(dtype_t) - 1) / sizeof(dtype_t);
+	GemmWorkspace scratch;
+	GemmWorkspace* ws = cpu_workspace_acquire(ctx, thread, (size_t)mc * kc * scale, (size_t)kc * nc * scale, &scratch);
+	if(!ws) {
+		TYPED(gemm_unpacked)(C, ldc, A, rs_a, cs_a, B, rs_b, cs_b, alpha, ni, nj, nk);
+		return;
+	}
+	REAL* block_a = (REAL*)ws->block_a;
+	REAL* block_b = (REAL*)ws->block_b;
+	if(ni <= mc && nj > nc) {
+		// short and wide: all of A is a single MC x KC block, so it is packed
+		// once per KC panel and the blocks of B stream past it (panel-panel)
+		// instead of being packed again for every one of them (block-panel)
+		for(uint32_t pc = 0; pc < nk; pc += kc) {
+			uint32_t K = MIN(kc, nk - pc);
+			// --- Pack A block into MR x KC micro-panels ---
+			TYPED(pack_a_panels)(block_a, &A[(size_t)pc * cs_a], rs_a, cs_a, ni, K, cfg->mr);
+			for(uint32_t jc = 0; jc < nj; jc += nc) {
+				uint32_t J = MIN(nc, nj - jc);
+				// --- Pack B block into KC x NR micro-panels ---
+				TYPED(pack_b_panels)(block_b, &B[(size_t)pc * rs_b + (size_t)jc * cs_b], rs_b, cs_b, K, J, cfg->nr);
+				TYPED(scale_packed)(block_b, (size_t)ALIGN_UP(J, cfg->nr) * K, alpha);
+				TYPED(blis_macro_kernel)(cfg, t, block_a, block_b, &C[jc], E ? &E[jc] : NULL, ldc, ni, K, J);
+			}
+		}
+		cpu_workspace_release(ws, &scratch);
+		return;
+	}
+	for(uint32_t jc = 0; jc < nj; jc += nc) {
+		uint32_t J = MIN(nc, nj - jc);
+		for(uint32_t pc = 0; pc < nk; pc += kc) {
+			uint32_t K = MIN(kc, nk - pc);
+			// --- Pack B block into KC x NR micro-panels ---
+			TYPED(pack_b_panels)(block_b, &B[(size_t)pc * rs_b + (size_t)jc * cs_b], rs_b, cs_b, K, J, cfg->nr);
+			TYPED(scale_packed)(block_b, (size_t)ALIGN_UP(J, cfg->nr) * K, alpha);
+			TYPED(blis_block)(cfg, t, block_a, block_b, C, E, ldc, A, rs_a, cs_a, ni, pc, jc, K, J);
+		}
+	}
+	cpu_workspace_release(ws, &scratch);
+}
+
+// C = beta C for a (m, n) block with row stride ldc. beta 0 stores zeros
+// without reading C, so NaNs in it don't propagate
+static void TYPED(scale_c)(REAL* C, uint32_t ldc, uint32_t m, uint32_t n, REAL beta) {
+	for(uint32_t i = 0; beta != 1 && i < m; i++) {
+		REAL* c = &C[(size_t)i * ldc];
+		if(beta == 0) {
+			memset(c, 0x00, n * sizeof(REAL));
+		} else {
+			for(uint32_t j = 0; j < n; j++) c[j] *= beta;
+		}
+	}
+}
+
+// C is cut along its longer side into one strip per thread (see cpu_strips).
+// The loop order inside a strip follows its own shape. Each thread applies beta
+// to its own strip before adding alpha A B to it (strides as in
+// gemm_blis_strided). E, when not NULL, gets the compensation terms of C
+static void TYPED(gemm_blis_strips)(const TYPED(BlisConfig)* cfg, GemmContext* ctx, const BlisTuning* t, uint32_t n_threads, REAL* C, REAL* E, uint32_t ldc, INPUT* A, uint32_t rs_a, uint32_t cs_a, INPUT* B, uint32_t rs_b, uint32_t cs_b, REAL alpha, REAL beta, uint32_t ni, uint32_t nj, uint32_t nk) {
+	if(!ni || !nj) {
+		return;
+	}
+	GemmStrips strips = cpu_strips(ni, nj, cfg->mr, cfg->nr, n_threads);
+	#pragma omp parallel num_threads(strips.count)
+	{
+		uint32_t thread = omp_get_thread_num(), size;
+		uint32_t begin = cpu_strip(&strips, thread, &size);
+		if(size && strips.by_rows) {
+			REAL* c = &C[(size_t)begin * ldc];
+			TYPED(scale_c)(c, ldc, size, nj, beta);
+			TYPED(gemm_blis_strided)(cfg, ctx, t, thread, c, E ? &E[(size_t)begin * ldc] : NULL, ldc, &A[(size_t)begin * rs_a], rs_a, cs_a, B, rs_b, cs_b, alpha, size, nj, nk);
+		} else if(size) {
+			TYPED(scale_c)(&C[begin], ldc, ni, size, beta);
+			TYPED(gemm_blis_strided)(cfg, ctx, t, thread, &C[begin], E ? &E[begin] : NULL, ldc, A, rs_a, cs_a, &B[(size_t)begin * cs_b], rs_b, cs_b, alpha, ni, size, nk);
+		}
+	}
+}
+
+#if GEMM_TYPE != GEMM_TYPE_F32
+// the generic micro-kernel: a register tile of MR rows of NV vectors of VLEN
+// elements. The tiles keep MR x NV accumulators, NV vectors of B and a
+// broadcast of A in registers: 14 x 2 of the 32 zmm, 6 x 2 of the 16 ymm/xmm,
+// and 4 x 8 scalars without SIMD. VMASK(n) selects the first n lanes of a
+// vector for the edge tiles, SSE2 has no masked moves and goes through a buffer
+#if defined(HAVE_AVX512) && GEMM_TYPE == GEMM_TYPE_F64
+#define VEC __m512d
+#define VLEN 8
+#define VZERO() _mm512_setzero_pd()
+#define VLOAD(p) _mm512_loadu_pd(p)
+#define VSTORE(p, v) _mm512_storeu_pd(p, v)
+#define VBROADCAST(x) _mm512_set1_pd(x)
+#define VADD(a, b) _mm512_add_pd(a, b)
+#define VFMA(a, b, c) _mm512_fmadd_pd(a, b, c)
+#define VMASK(n) ((__mmask8)((1u << (n)) - 1))
+#define VLOAD_MASKED(p, mask) _mm512_maskz_loadu_pd(mask, p)
+#define VSTORE_MASKED(p, mask, v) _mm512_mask_storeu_pd(p, mask, v)
+#define MR 14
+#define NV 2
+#elif defined(HAVE_AVX512)
+#define VEC __m512
+#define VLEN 16
+#define VZERO() _mm512_setzero_ps()
+#define VLOAD(p) _mm512_loadu_ps(p)
+#define VSTORE(p, v) _mm512_storeu_ps(p, v)
+#define VBROADCAST(x) _mm512_set1_ps(x)
+#define VADD(a, b) _mm512_add_ps(a, b)
+#define VFMA(a, b, c) _mm512_fmadd_ps(a, b, c)
+#define VMASK(n) ((__mmask16)((1u << (n)) - 1))
+#define VLOAD_MASKED(p, mask) _mm512_maskz_loadu_ps(mask, p)
+#define VSTORE_MASKED(p, mask, v) _mm512_mask_storeu_ps(p, mask, v)
+#define MR 14
+#define NV 2
+#elif defined(HAVE_AVX2) && GEMM_TYPE == GEMM_TYPE_F64
+// 4-wide fp64: a 6 x 8 tile, 12 accumulators
+#define VEC __m256d
+#define VLEN 4
+#define VZERO() _mm256_setzero_pd()
+#define VLOAD(p) _mm256_loadu_pd(p)
+#define VSTORE(p, v) _mm256_storeu_pd(p, v)
+#define VBROADCAST(x) _mm256_set1_pd(x)
+#define VADD(a, b) _mm256_add_pd(a, b)
+#define VFMA(a, b, c) _mm256_fmadd_pd(a, b, c)
+#define VMASK(n) _mm256_cmpgt_epi64(_mm256_set1_epi64x(n), _mm256_setr_epi64x(0, 1, 2, 3))
+#define VLOAD_MASKED(p, mask) _mm256_maskload_pd(p, mask)
+#define VSTORE_MASKED(p, mask, v) _mm256_maskstore_pd(p, mask, v)
+#define MR 6
+#define NV 2
+#elif defined(HAVE_AVX2)
+#define VEC __m256
+#define VLEN 8
+#define VZERO() _mm256_setzero_ps()
+#define VLOAD(p) _mm256_loadu_ps(p)
+#define VSTORE(p, v) _mm256_storeu_ps(p, v)
+#define VBROADCAST(x) _mm256_set1_ps(x)
+#define VADD(a, b) _mm256_add_ps(a, b)
+#define VFMA(a, b, c) _mm256_fmadd_ps(a, b, c)
+#define VMASK(n) _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))
+#define VLOAD_MASKED(p, mask) _mm256_maskload_ps(p, mask)
+#define VSTORE_MASKED(p, mask, v) _mm256_maskstore_ps(p, mask, v)
+#define MR 6
+#define NV 2
+#elif defined(HAVE_SSE2) && GEMM_TYPE == GEMM_TYPE_F64
+#define VEC __m128d
+#define VLEN 2
+#define VZERO() _mm_setzero_pd()
+#define VLOAD(p) _mm_loadu_pd(p)
+#define VSTORE(p, v) _mm_storeu_pd(p, v)
+#define VBROADCAST(x) _mm_set1_pd(x)
+#define VADD(a, b) _mm_add_pd(a, b)
+#define VFMA(a, b, c) _mm_add_pd(_mm_mul_pd(a, b), c)
+#define MR 6
+#define NV 2
+#elif defined(HAVE_SSE2)
+#define VEC __m128
+#define VLEN 4
+#define VZERO() _mm_setzero_ps()
+#define VLOAD(p) _mm_loadu_ps(p)
+#define VSTORE(p, v) _mm_storeu_ps(p, v)
+#define VBROADCAST(x) _mm_set1_ps(x)
+#define VADD(a, b) _mm_add_ps(a, b)
+#define VFMA(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#define MR 6
+#define NV 2
+#else
+#define VEC REAL
+#define VLEN 1
+#define VZERO() 0
+#define VLOAD(p) (*(p))
+#define VSTORE(p, v) (*(p) = (v))
+#define VBROADCAST(x) (x)
+#define VADD(a, b) ((a) + (b))
+#define VFMA(a, b, c) ((a) * (b) + (c))
+// one lane per vector, the edge loop never reaches past n
+#define VMASK(n) (n)
+#define VLOAD_MASKED(p, mask) ((void)(mask), VLOAD(p))
+#define VSTORE_MASKED(p, mask, v) ((void)(mask), VSTORE(p, v))
+#define MR 4
+#define NV 8
+#endif
+#define NR (NV * VLEN)
+
+static void TYPED(micro_kernel)(uint32_t k, REAL* a, REAL* b, REAL* C, uint32_t ldc, uint32_t m, uint32_t n) {
+	VEC acc[MR][NV];
+	_Pragma("GCC unroll 16")
+	for(uint32_t i = 0; i < MR; i++) {
+		_Pragma("GCC unroll 8")
+		for(uint32_t v = 0; v < NV; v++) acc[i][v] = VZERO();
+	}
+	for(uint32_t ik = 0; ik < k; ik++) {
+		VEC bv[NV];
+		_Pragma("GCC unroll 8")
+		for(uint32_t v = 0; v < NV; v++) bv[v] = VLOAD(&b[v * VLEN]);
+		_Pragma("GCC unroll 16")
+		for(uint32_t i = 0; i < MR; i++) {
+			VEC ai = VBROADCAST(a[i]);
+			_Pragma("GCC unroll 8")
+			for(uint32_t v = 0; v < NV; v++) acc[i][v] = VFMA(ai, bv[v], acc[i][v]);
+		}
+		a += MR;
+		b += NR;
+	}
+	if(m == MR && n == NR) {
+		_Pragma("GCC unroll 16")
+		for(uint32_t i = 0; i < MR; i++) {
+			_Pragma("GCC unroll 8")
+			for(uint32_t v = 0; v < NV; v++) VSTORE(&C[i * ldc + v * VLEN], VADD(VLOAD(&C[i * ldc + v * VLEN]), acc[i][v]));
+		}
+		return;
+	}
+#ifdef VMASK
+	// edge tiles: the rows past m are skipped and the lanes past n masked
+	_Pragma("GCC unroll 16")
+	for(uint32_t i = 0; i < MR; i++) {
+		if(i >= m) {
+			break;
+		}
+		_Pragma("GCC unroll 8")
+		for(uint32_t v = 0; v < NV; v++) {
+			if(v * VLEN >= n) {
+				break;
+			}
+			REAL* c = &C[i * ldc + v * VLEN];
+			uint32_t lanes = MIN(VLEN, n - v * VLEN);
+			VSTORE_MASKED(c, VMASK(lanes), VADD(VLOAD_MASKED(c, VMASK(lanes)), acc[i][v]));
+		}
+	}
+#else
+	REAL tile[MR * NR];
+	_Pragma("GCC unroll 16")
+	for(uint32_t i = 0; i < MR; i++) {
+		_Pragma("GCC unroll 8")
+		for(uint32_t v = 0; v < NV; v++) VSTORE(&tile[i * NR + v * VLEN], acc[i][v]);
+	}
+	for(uint32_t i = 0; i < m; i++) {
+		for(uint32_t j = 0; j < n; j++) C[i * ldc + j] += tile[i * NR + j];
+	}
+#endif
+}
+
+#define TYPED_KERNELS { TYPED(micro_kernel), TYPED(micro_kernel), TYPED(micro_kernel) }
+static const TYPED(BlisConfig) TYPED(blis) = { TYPED_KERNELS, TYPED_KERNELS, MR, NR, NR, -1 };
+#undef TYPED_KERNELS
+
+// MC/KC/NC of the analytical model for the tile and the size of REAL, set by a
+// load-time constructor. gemm --tune doesn't search them
+static BlisTuning TYPED(tuning);
+
+__attribute__((constructor)) static void TYPED(init_tuning)(void) {
+	BlisBlocking b = cpu_blis_blocking(MR, NR, sizeof(REAL));
+	// the packing buffers hold whole micro-panels
+	BlisTuning t = {
+		.name = "generic",
+		.mr = MR,
+		.nr = NR,
+		.mc = MAX(MR, b.mc / MR * MR),
+		.kc = b.kc,
+		.nc = MAX(NR, b.nc / NR * NR),
+		.order = LOOP_ORDER_JR_IR,
+		.unroll = 1,
+	};
+	TYPED(tuning) = t;
+}
+
+void TYPED(gemm_blas)(void* userdata, GemmLayout layout, GemmTranspose trans_a, GemmTranspose trans_b, uint32_t ni, uint32_t nj, uint32_t nk, REAL alpha, INPUT* A, uint32_t lda, INPUT* B, uint32_t ldb, REAL beta, REAL* C, uint32_t ldc) {
+	if(!ni || !nj) {
+		return;
+	}
+	// same strides and column major C as gemm_blas
+	uint32_t rs_a = (layout == GEMM_ROW_MAJOR) != (trans_a == GEMM_TRANS) ? lda : 1;
+	uint32_t cs_a = rs_a == 1 ? lda : 1;
+	uint32_t rs_b = (layout == GEMM_ROW_MAJOR) != (trans_b == GEMM_TRANS) ? ldb : 1;
+	uint32_t cs_b = rs_b == 1 ? ldb : 1;
+	if(layout == GEMM_COL_MAJOR) {
+		uint32_t n = ni, rs = rs_a, cs = cs_a;
+		INPUT* X = A;
+		ni = nj, nj = n;
+		A = B, rs_a = cs_b, cs_a = rs_b;
+		B = X, rs_b = cs, cs_b = rs;
+	}
+	GemmContext* ctx = userdata;
+	if(!nk || alpha == 0) {
+		TYPED(scale_c)(C, ldc, ni, nj, beta);
+		return;
+	}
+	TYPED(gemm_blis_strips)(&TYPED(blis), ctx, &TYPED(tuning), cpu_gemm_threads(ctx, ni, nj, nk), C, NULL, ldc, A, rs_a, cs_a, B, rs_b, cs_b, alpha, beta, ni, nj, nk);
+}
+
+#undef VEC
+#undef VLEN
+#undef VZERO
+#undef VLOAD
+#undef VSTORE
+#undef VBROADCAST
+#undef VADD
+#undef VFMA
+#ifdef VMASK
+#undef VMASK
+#undef VLOAD_MASKED
+#undef VSTORE_MASKED
+#endif
+#undef MR
+#undef NV
+#undef NR
+#endif
+
+#undef REAL
+#undef INPUT
+#undef TO_REAL
+#undef ABS
+#undef TYPED
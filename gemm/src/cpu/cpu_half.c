@@ -0,0 +1,45 @@
+#include "cpu/cpu_half.h"
+
+bf16_t cpu_f32_to_bf16(float x) {
+	uint32_t u;
+	memcpy(&u, &x, sizeof(u));
+	if((u & 0x7fffffff) > 0x7f800000) {
+		// quiet NaN, which truncation could turn into an infinity
+		return (bf16_t)((u >> 16) | 0x40);
+	}
+	u += 0x7fff + ((u >> 16) & 1);
+	return (bf16_t)(u >> 16);
+}
+
+f16_t cpu_f32_to_f16(float x) {
+	uint32_t u;
+	memcpy(&u, &x, sizeof(u));
+	uint32_t sign = (u >> 16) & 0x8000, magnitude = u & 0x7fffffff;
+	if(magnitude > 0x7f800000) {
+		return (f16_t)(sign | 0x7e00);
+	}
+	// 65520 and above (infinity included) round to infinity
+	if(magnitude >= 0x477ff000) {
+		return (f16_t)(sign | 0x7c00);
+	}
+	if(magnitude < 0x38800000) {
+		// subnormal: adding 0.5 leaves the mantissa in units of 2^-24, rounded
+		// to nearest even by the addition itself
+		float f, half = 0.5f;
+		memcpy(&f, &magnitude, sizeof(f));
+		f += half;
+		memcpy(&magnitude, &f, sizeof(f));
+		return (f16_t)(sign | (magnitude - 0x3f000000));
+	}
+	// rebias the exponent and round the 13 dropped bits to nearest even
+	magnitude += 0xc8000fff + ((magnitude >> 13) & 1);
+	return (f16_t)(sign | (magnitude >> 13));
+}
+
+void cpu_bf16_from_f32(bf16_t* dst, const float* src, size_t n) {
+	for(size_t i = 0; i < n; i++) dst[i] = cpu_f32_to_bf16(src[i]);
+}
+
+void cpu_f16_from_f32(f16_t* dst, const float* src, size_t n) {
+	for(size_t i = 0; i < n; i++) dst[i] = cpu_f32_to_f16(src[i]);
+}
@@ -0,0 +1,353 @@
+// mmap flags
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "cpu/cpu_jit.h"
+
+// general purpose registers, in their x86 encoding
+enum { RAX = 0, RCX = 1, RDX = 2, RSI = 6, RDI = 7, R8 = 8, R9 = 9 };
+
+// code is emitted into a growing heap buffer and copied into its own pages
+// once complete, so no page is ever writable and executable at the same time
+typedef struct {
+	uint8_t* code;
+	size_t size;
+	size_t capacity;
+	int failed; // out of memory
+} Emitter;
+
+static void emit(Emitter* e, const void* bytes, size_t n) {
+	if(e->size + n > e->capacity) {
+		size_t capacity = e->capacity ? e->capacity * 2 : 4096;
+		uint8_t* code = e->failed ? NULL : realloc(e->code, capacity);
+		if(!code) {
+			e->failed = 1;
+			return;
+		}
+		e->code = code;
+		e->capacity = capacity;
+	}
+	memcpy(e->code + e->size, bytes, n);
+	e->size += n;
+}
+
+static void emit_u8(Emitter* e, uint8_t b) {
+	emit(e, &b, 1);
+}
+
+static void emit_u32(Emitter* e, uint32_t v) {
+	uint8_t b[4] = { v, v >> 8, v >> 16, v >> 24 };
+	emit(e, b, 4);
+}
+
+static void emit_u64(Emitter* e, uint64_t v) {
+	emit_u32(e, v);
+	emit_u32(e, v >> 32);
+}
+
+// 0F 85 rel32 with the displacement patched later, returns its position
+static size_t emit_jne(Emitter* e) {
+	emit_u8(e, 0x0F);
+	emit_u8(e, 0x85);
+	emit_u32(e, 0);
+	return e->size - 4;
+}
+
+static void patch_rel32(Emitter* e, size_t at, size_t target) {
+	if(e->failed) {
+		return;
+	}
+	uint32_t rel = (uint32_t)(target - (at + 4));
+	uint8_t b[4] = { rel, rel >> 8, rel >> 16, rel >> 24 };
+	memcpy(e->code + at, b, 4);
+}
+
+// opcode maps and mandatory prefixes of the vector instructions
+#define MAP_0F 1
+#define MAP_0F38 2
+#define PP_NONE 0
+#define PP_66 1
+
+#define NO_BASE -1
+
+// one 256-bit VEX (AVX2) or 512-bit EVEX (AVX-512) instruction. reg and vvvv
+// are vector registers, the r/m operand is vector register rm when base is
+// NO_BASE and [base + disp32] otherwise. Always disp32, so EVEX never needs
+// its scaled disp8
+static void emit_vec(Emitter* e, JitIsa isa, uint8_t map, uint8_t pp, uint8_t opcode, uint32_t reg, uint32_t vvvv, uint32_t rm, int base, int32_t disp) {
+	uint32_t b = base == NO_BASE ? rm : (uint32_t)base;
+	// register operands past 15 put their fifth bit in EVEX.X
+	uint32_t x = base == NO_BASE ? rm >> 4 : 0;
+	if(isa == JIT_AVX2) {
+		emit_u8(e, 0xC4);
+		emit_u8(e, (!(reg & 8)) << 7 | 1 << 6 | (!(b & 8)) << 5 | map);
+		emit_u8(e, (~vvvv & 15) << 3 | 1 << 2 | pp);
+	} else {
+		emit_u8(e, 0x62);
+		emit_u8(e, (!(reg & 8)) << 7 | (!(x & 1)) << 6 | (!(b & 8)) << 5 | (!(reg & 16)) << 4 | map);
+		emit_u8(e, (~vvvv & 15) << 3 | 1 << 2 | pp);
+		emit_u8(e, 2 << 5 | (!(vvvv & 16)) << 3);
+	}
+	emit_u8(e, opcode);
+	if(base == NO_BASE) {
+		emit_u8(e, 0xC0 | (reg & 7) << 3 | (rm & 7));
+	} else {
+		// mod 10: [base + disp32], no SIB since base is never rsp or r12
+		emit_u8(e, 0x80 | (reg & 7) << 3 | (base & 7));
+		emit_u32(e, (uint32_t)disp);
+	}
+}
+
+static void emit_zero(Emitter* e, JitIsa isa, uint32_t r) {
+	// vxorps on zmm needs AVX512DQ, vpxord is AVX-512F
+	if(isa == JIT_AVX2) {
+		emit_vec(e, isa, MAP_0F, PP_NONE, 0x57, r, r, r, NO_BASE, 0);
+	} else {
+		emit_vec(e, isa, MAP_0F, PP_66, 0xEF, r, r, r, NO_BASE, 0);
+	}
+}
+
+static void emit_load(Emitter* e, JitIsa isa, uint32_t r, int base, int32_t disp) {
+	emit_vec(e, isa, MAP_0F, PP_NONE, 0x10, r, 0, 0, base, disp); // vmovups
+}
+
+static void emit_store(Emitter* e, JitIsa isa, uint32_t r, int base, int32_t disp) {
+	emit_vec(e, isa, MAP_0F, PP_NONE, 0x11, r, 0, 0, base, disp); // vmovups
+}
+
+static void emit_broadcast(Emitter* e, JitIsa isa, uint32_t r, int base, int32_t disp) {
+	emit_vec(e, isa, MAP_0F38, PP_66, 0x18, r, 0, 0, base, disp); // vbroadcastss
+}
+
+static void emit_fma(Emitter* e, JitIsa isa, uint32_t acc, uint32_t x, uint32_t y) {
+	emit_vec(e, isa, MAP_0F38, PP_66, 0xB8, acc, x, y, NO_BASE, 0); // vfmadd231ps
+}
+
+static void emit_add_mem(Emitter* e, JitIsa isa, uint32_t r, int base, int32_t disp) {
+	emit_vec(e, isa, MAP_0F, PP_NONE, 0x58, r, r, 0, base, disp); // vaddps
+}
+
+// add reg64, imm32
+static void emit_add_imm(Emitter* e, uint32_t reg, uint32_t imm) {
+	emit_u8(e, 0x48 | (reg >> 3));
+	emit_u8(e, 0x81);
+	emit_u8(e, 0xC0 | (reg & 7));
+	emit_u32(e, imm);
+}
+
+// shape of the generated loop nest: L lines of C (rows for row major C, columns
+// for column major) of V elements, each line nv vectors of w lanes
+typedef struct {
+	const JitSpec* spec;
+	uint32_t w;
+	uint32_t nv;
+	uint32_t lines;
+	uint32_t v_elements;
+	int vec_ptr; // micro-panel loaded as vectors
+	int bcast_ptr; // micro-panel broadcast a lane at a time
+} Shape;
+
+// registers: the accumulators first, then the vectors of the micro-panel and
+// the broadcast
+#define ACC(s, l, v) ((l) * (s)->nv + (v))
+#define VEC(s, v) ((s)->lines * (s)->nv + (v))
+#define BCAST(s) ((s)->lines * (s)->nv + (s)->nv)
+
+// one k step, at offset ik from the current position of the micro-panels
+static void emit_step(Emitter* e, const Shape* s, uint32_t ik) {
+	JitIsa isa = s->spec->isa;
+	for(uint32_t v = 0; v < s->nv; v++) {
+		emit_load(e, isa, VEC(s, v), s->vec_ptr, (ik * s->v_elements + v * s->w) * sizeof(dtype_t));
+	}
+	for(uint32_t l = 0; l < s->lines; l++) {
+		emit_broadcast(e, isa, BCAST(s), s->bcast_ptr, (ik * s->lines + l) * sizeof(dtype_t));
+		for(uint32_t v = 0; v < s->nv; v++) {
+			emit_fma(e, isa, ACC(s, l, v), BCAST(s), VEC(s, v));
+		}
+	}
+}
+
+// k steps unrolled this many times inside the loop, the k % JIT_UNROLL left
+// over are unrolled after it
+#define JIT_UNROLL 4
+
+// System V arguments: edi = k, rsi = a, rdx = b, rcx = C, r8d = ldc, r9d = m,
+// [rsp + 8] = n
+static void generate(Emitter* e, const JitSpec* spec) {
+	Shape s = { .spec = spec, .w = spec->isa == JIT_AVX2 ? 8 : 16 };
+	int row_major = spec->layout == GEMM_ROW_MAJOR;
+	s.v_elements = row_major ? spec->nr : spec->mr;
+	s.lines = row_major ? spec->mr : spec->nr;
+	s.nv = s.v_elements / s.w;
+	s.vec_ptr = row_major ? RDX : RSI;
+	s.bcast_ptr = row_major ? RSI : RDX;
+
+	// --- anything but the shape it was generated for goes to the fallback ---
+	size_t to_fallback[3];
+	emit_u8(e, 0x81); emit_u8(e, 0xFF); emit_u32(e, spec->k); // cmp edi, k
+	to_fallback[0] = emit_jne(e);
+	emit_u8(e, 0x41); emit_u8(e, 0x81); emit_u8(e, 0xF9); emit_u32(e, spec->mr); // cmp r9d, mr
+	to_fallback[1] = emit_jne(e);
+	emit_u8(e, 0x81); emit_u8(e, 0x7C); emit_u8(e, 0x24); emit_u8(e, 0x08); emit_u32(e, spec->nr); // cmp dword [rsp + 8], nr
+	to_fallback[2] = emit_jne(e);
+
+	// ldc in bytes, the upper half of r8 is undefined for a uint32_t argument
+	emit_u8(e, 0x45); emit_u8(e, 0x89); emit_u8(e, 0xC0); // mov r8d, r8d
+	emit_u8(e, 0x49); emit_u8(e, 0xC1); emit_u8(e, 0xE0); emit_u8(e, 0x02); // shl r8, 2
+	for(uint32_t l = 0; l < s.lines; l++) {
+		for(uint32_t v = 0; v < s.nv; v++) emit_zero(e, spec->isa, ACC(&s, l, v));
+	}
+
+	// --- k loop, its trip count a constant ---
+	uint32_t unroll = spec->k < JIT_UNROLL ? spec->k : JIT_UNROLL;
+	uint32_t iterations = unroll ? spec->k / unroll : 0;
+	if(iterations) {
+		emit_u8(e, 0xB8); emit_u32(e, iterations); // mov eax, iterations
+		// loop top on a 32 byte boundary for the decoders (code starts on a page)
+		while(e->size % 32) emit_u8(e, 0x90); // nop
+		size_t top = e->size;
+		for(uint32_t u = 0; u < unroll; u++) emit_step(e, &s, u);
+		emit_add_imm(e, s.vec_ptr, unroll * s.v_elements * sizeof(dtype_t));
+		emit_add_imm(e, s.bcast_ptr, unroll * s.lines * sizeof(dtype_t));
+		emit_u8(e, 0xFF); emit_u8(e, 0xC8); // dec eax
+		patch_rel32(e, emit_jne(e), top);
+	}
+	for(uint32_t u = 0; u < spec->k - iterations * unroll; u++) emit_step(e, &s, u);
+
+	// --- epilogue: a line of C at a time, rcx walking down them ---
+	for(uint32_t l = 0; l < s.lines; l++) {
+		for(uint32_t v = 0; v < s.nv; v++) {
+			int32_t disp = v * s.w * sizeof(dtype_t);
+			if(spec->epilogue == JIT_ACCUMULATE) {
+				emit_add_mem(e, spec->isa, ACC(&s, l, v), RCX, disp);
+			}
+			emit_store(e, spec->isa, ACC(&s, l, v), RCX, disp);
+		}
+		if(l + 1 < s.lines) {
+			emit_u8(e, 0x4C); emit_u8(e, 0x01); emit_u8(e, 0xC1); // add rcx, r8
+		}
+	}
+	emit_u8(e, 0xC5); emit_u8(e, 0xF8); emit_u8(e, 0x77); // vzeroupper
+	emit_u8(e, 0xC3); // ret
+
+	// the arguments are untouched until the checks pass, so a tail call does
+	for(uint32_t i = 0; i < 3; i++) patch_rel32(e, to_fallback[i], e->size);
+	emit_u8(e, 0x48); emit_u8(e, 0xB8); emit_u64(e, (uint64_t)(uintptr_t)spec->fallback); // mov rax, fallback
+	emit_u8(e, 0xFF); emit_u8(e, 0xE0); // jmp rax
+}
+
+static int fits(const JitSpec* spec) {
+	uint32_t w = spec->isa == JIT_AVX2 ? 8 : 16, registers = spec->isa == JIT_AVX2 ? 16 : 32;
+	uint32_t v_elements = spec->layout == GEMM_ROW_MAJOR ? spec->nr : spec->mr;
+	uint32_t lines = spec->layout == GEMM_ROW_MAJOR ? spec->mr : spec->nr;
+	if(!spec->fallback || !lines || !v_elements || v_elements % w) {
+		return 0;
+	}
+	uint32_t nv = v_elements / w;
+	return lines * nv + nv + 1 <= registers;
+}
+
+typedef struct {
+	JitSpec spec;
+	void* code;
+	size_t map_size;
+} JitEntry;
+
+static JitEntry* entries = NULL;
+static uint32_t n_entries = 0;
+static uint32_t capacity = 0;
+static JitStats stats = {0};
+
+// field by field, JitSpec has padding
+static int spec_equal(const JitSpec* a, const JitSpec* b) {
+	return a->isa == b->isa && a->mr == b->mr && a->nr == b->nr && a->k == b->k &&
+		a->layout == b->layout && a->epilogue == b->epilogue && a->fallback == b->fallback;
+}
+
+static int jit_enabled(void) {
+	const char* env = getenv("GEMM_JIT");
+	return !env || strcmp(env, "0");
+}
+
+// machine code for spec in pages of its own, read-only and executable
+static JitKernel compile(const JitSpec* spec, JitEntry* entry) {
+	Emitter e = {0};
+	generate(&e, spec);
+	void* code = MAP_FAILED;
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t map_size = (e.size + page - 1) / page * page;
+	if(!e.failed) {
+		code = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	if(code != MAP_FAILED) {
+		memcpy(code, e.code, e.size);
+		if(mprotect(code, map_size, PROT_READ | PROT_EXEC)) {
+			munmap(code, map_size);
+			code = MAP_FAILED;
+		}
+	}
+	free(e.code);
+	if(code == MAP_FAILED) {
+		return NULL;
+	}
+	*entry = (JitEntry){ .spec = *spec, .code = code, .map_size = map_size };
+	stats.kernels++;
+	stats.bytes += e.size;
+	// object to function pointer, which POSIX guarantees for mmap'd code
+	JitKernel kernel;
+	memcpy(&kernel, &code, sizeof(kernel));
+	return kernel;
+}
+
+JitKernel cpu_jit_kernel(const JitSpec* spec) {
+	if(!fits(spec) || !jit_enabled()) {
+		return NULL;
+	}
+	JitKernel kernel = NULL;
+	#pragma omp critical(cpu_jit)
+	{
+		for(uint32_t i = 0; i < n_entries && !kernel; i++) {
+			if(spec_equal(&entries[i].spec, spec)) {
+				memcpy(&kernel, &entries[i].code, sizeof(kernel));
+				stats.hits++;
+			}
+		}
+		if(!kernel) {
+			stats.misses++;
+			if(n_entries == capacity) {
+				uint32_t grown = capacity ? capacity * 2 : 16;
+				JitEntry* e = realloc(entries, grown * sizeof(JitEntry));
+				if(e) {
+					entries = e;
+					capacity = grown;
+				}
+			}
+			if(n_entries < capacity && (kernel = compile(spec, &entries[n_entries]))) {
+				n_entries++;
+			}
+		}
+	}
+	return kernel;
+}
+
+JitStats cpu_jit_stats(void) {
+	JitStats s;
+	#pragma omp critical(cpu_jit)
+	s = stats;
+	return s;
+}
+
+void cpu_jit_clear(void) {
+	#pragma omp critical(cpu_jit)
+	{
+		for(uint32_t i = 0; i < n_entries; i++) munmap(entries[i].code, entries[i].map_size);
+		free(entries);
+		entries = NULL;
+		n_entries = capacity = 0;
+		stats.kernels = 0;
+		stats.bytes = 0;
+	}
+}
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include "cpu/cpu_pack_cache.h"
+
+void cpu_pack_cache_init(PackCache* cache, size_t budget) {
+	*cache = (PackCache){ .budget = budget };
+}
+
+void cpu_pack_cache_clear(PackCache* cache) {
+	for(uint32_t i = 0; i < cache->n_entries; i++) {
+		gemm_packed_b_free(cache->entries[i].packed);
+	}
+	cache->n_entries = 0;
+	cache->stats.bytes = 0;
+	cache->stats.entries = 0;
+}
+
+void cpu_pack_cache_free(PackCache* cache) {
+	cpu_pack_cache_clear(cache);
+	free(cache->entries);
+	cache->entries = NULL;
+	cache->capacity = 0;
+}
+
+static void evict(PackCache* cache, uint32_t i) {
+	cache->stats.bytes -= cache->entries[i].bytes;
+	cache->stats.entries--;
+	cache->stats.evictions++;
+	gemm_packed_b_free(cache->entries[i].packed);
+	cache->entries[i] = cache->entries[--cache->n_entries];
+}
+
+// least recently used entry not pinned by the current call, -1 if none
+static int lru(PackCache* cache) {
+	int victim = -1;
+	for(uint32_t i = 0; i < cache->n_entries; i++) {
+		if(cache->entries[i].last_use != cache->clock && (victim < 0 || cache->entries[i].last_use < cache->entries[victim].last_use)) {
+			victim = i;
+		}
+	}
+	return victim;
+}
+
+// evicts until bytes more fit, 0 on success
+static int make_room(PackCache* cache, size_t bytes) {
+	while(cache->stats.bytes + bytes > cache->budget) {
+		int victim = lru(cache);
+		if(victim < 0) {
+			return -1;
+		}
+		evict(cache, victim);
+	}
+	return 0;
+}
+
+void cpu_pack_cache_set_budget(PackCache* cache, size_t budget) {
+	cache->budget = budget;
+	// nothing is pinned between calls
+	cache->clock++;
+	make_room(cache, 0);
+}
+
+void cpu_pack_cache_begin(PackCache* cache) {
+	cache->clock++;
+}
+
+// field by field, the padding of PackKey is undefined
+static int key_equal(const PackKey* a, const PackKey* b) {
+	return a->src == b->src && a->nk == b->nk && a->n == b->n && a->layout == b->layout &&
+		a->epoch == b->epoch && a->kc == b->kc && a->nc == b->nc && a->nr == b->nr;
+}
+
+GemmPackedB* cpu_pack_cache_find(PackCache* cache, const PackKey* key) {
+	for(uint32_t i = 0; i < cache->n_entries; i++) {
+		if(key_equal(&cache->entries[i].key, key)) {
+			cache->entries[i].last_use = cache->clock;
+			cache->stats.hits++;
+			return cache->entries[i].packed;
+		}
+	}
+	cache->stats.misses++;
+	return NULL;
+}
+
+int cpu_pack_cache_reserve(PackCache* cache, size_t bytes) {
+	return bytes > cache->budget ? -1 : make_room(cache, bytes);
+}
+
+int cpu_pack_cache_insert(PackCache* cache, const PackKey* key, GemmPackedB* packed) {
+	size_t bytes = cpu_packed_b_bytes(packed);
+	if(cpu_pack_cache_reserve(cache, bytes)) {
+		return -1;
+	}
+	if(cache->n_entries == cache->capacity) {
+		uint32_t capacity = cache->capacity ? cache->capacity * 2 : 16;
+		PackCacheEntry* entries = realloc(cache->entries, capacity * sizeof(PackCacheEntry));
+		if(!entries) {
+			return -1;
+		}
+		cache->entries = entries;
+		cache->capacity = capacity;
+	}
+	cache->entries[cache->n_entries++] = (PackCacheEntry){ .key = *key, .packed = packed, .bytes = bytes, .last_use = cache->clock };
+	cache->stats.bytes += bytes;
+	cache->stats.entries++;
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include <stdlib.h>
+#include "cpu/cpu_packed.h"
+#include "cpu/cpu_alloc.h"
+
+#define ALIGN_UP(x, n) (((x) + (n) - 1) / (n) * (n))
+
+// every NC block is padded to whole micro-panels
+static size_t packed_size(uint32_t nk, uint32_t nj, uint32_t nc, uint32_t nr) {
+	return (size_t)(nj / nc) * ALIGN_UP(nc, nr) * nk + (size_t)ALIGN_UP(nj % nc, nr) * nk;
+}
+
+GemmPackedB* cpu_packed_b_create(uint32_t nk, uint32_t nj, uint32_t kc, uint32_t nc, uint32_t nr) {
+	GemmPackedB* packed = malloc(sizeof(GemmPackedB));
+	if(!packed) {
+		return NULL;
+	}
+	*packed = (GemmPackedB){ .nk = nk, .nj = nj, .kc = kc, .nc = nc, .nr = nr };
+	size_t size = packed_size(nk, nj, nc, nr);
+	packed->panels = cpu_alloc(size ? size * sizeof(dtype_t) : 1);
+	if(!packed->panels) {
+		free(packed);
+		return NULL;
+	}
+	return packed;
+}
+
+void gemm_packed_b_free(GemmPackedB* packed) {
+	if(!packed) {
+		return;
+	}
+	cpu_free(packed->panels);
+	free(packed);
+}
+
+size_t cpu_packed_b_bytes(const GemmPackedB* packed) {
+	return cpu_packed_b_size(packed->nk, packed->nj, packed->nc, packed->nr);
+}
+
+size_t cpu_packed_b_size(uint32_t nk, uint32_t nj, uint32_t nc, uint32_t nr) {
+	return packed_size(nk, nj, nc, nr) * sizeof(dtype_t);
+}
+
+dtype_t* cpu_packed_b_block(const GemmPackedB* packed, uint32_t pc, uint32_t jc, uint32_t J) {
+	size_t offset = (size_t)(jc / packed->nc) * ALIGN_UP(packed->nc, packed->nr) * packed->nk;
+	return packed->panels + offset + (size_t)pc * ALIGN_UP(J, packed->nr);
+}
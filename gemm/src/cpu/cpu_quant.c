@@ -0,0 +1,16 @@
+#include <math.h>
+#include "cpu/cpu_quant.h"
+
+// saturated in float, before the conversion could overflow
+static int32_t quantize(float x, float scale, int32_t zero_point, int32_t low, int32_t high) {
+	float q = nearbyintf(x / scale) + (float)zero_point;
+	return q < low ? low : q > high ? high : (int32_t)q;
+}
+
+void cpu_quantize_u8(uint8_t* dst, const float* src, size_t n, float scale, int32_t zero_point) {
+	for(size_t i = 0; i < n; i++) dst[i] = (uint8_t)quantize(src[i], scale, zero_point, 0, 255);
+}
+
+void cpu_quantize_s8(int8_t* dst, const float* src, size_t n, float scale, int32_t zero_point) {
+	for(size_t i = 0; i < n; i++) dst[i] = (int8_t)quantize(src[i], scale, zero_point, -128, 127);
+}
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cpu/cpu_tiled.h"
+#include "cpu/cpu_tune.h"
+#include "cpu/cpu_alloc.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define ALIGN_UP(x, n) (((x) + (n) - 1) / (n) * (n))
+
+TiledMatrix* cpu_tiled_create(uint32_t rows, uint32_t cols, uint32_t tile) {
+	TiledMatrix* m = malloc(sizeof(TiledMatrix));
+	if(!m) {
+		return NULL;
+	}
+	tile = ALIGN_UP(tile ? tile : cpu_tuning()->blocksize, TILED_GRANULE);
+	*m = (TiledMatrix){
+		.rows = rows,
+		.cols = cols,
+		.tile = tile,
+		.tile_rows = (rows + tile - 1) / tile,
+		.tile_cols = (cols + tile - 1) / tile,
+	};
+	size_t size = (size_t)m->tile_rows * m->tile_cols * tile * tile;
+	m->data = cpu_calloc(size ? size : 1, sizeof(dtype_t));
+	if(!m->data) {
+		free(m);
+		return NULL;
+	}
+	return m;
+}
+
+void cpu_tiled_free(TiledMatrix* m) {
+	if(!m) {
+		return;
+	}
+	cpu_free(m->data);
+	free(m);
+}
+
+TiledMatrix* cpu_tiled_from(const dtype_t* src, uint32_t rows, uint32_t cols, GemmLayout layout, uint32_t tile) {
+	TiledMatrix* m = cpu_tiled_create(rows, cols, tile);
+	if(!m) {
+		return NULL;
+	}
+	tile = m->tile;
+	for(uint32_t ti = 0; ti < m->tile_rows; ti++) {
+		uint32_t I = MIN(tile, rows - ti * tile);
+		for(uint32_t tj = 0; tj < m->tile_cols; tj++) {
+			uint32_t J = MIN(tile, cols - tj * tile);
+			dtype_t* t = cpu_tiled_tile(m, ti, tj);
+			const dtype_t* s = layout == GEMM_ROW_MAJOR ? &src[(size_t)ti * tile * cols + tj * tile] : &src[(size_t)tj * tile * rows + ti * tile];
+			if(layout == GEMM_ROW_MAJOR) {
+				for(uint32_t i = 0; i < I; i++) memcpy(&t[i * tile], &s[(size_t)i * cols], J * sizeof(dtype_t));
+			} else {
+				// column major sources are transposed a column at a time
+				for(uint32_t j = 0; j < J; j++) {
+					for(uint32_t i = 0; i < I; i++) t[i * tile + j] = s[(size_t)j * rows + i];
+				}
+			}
+		}
+	}
+	return m;
+}
+
+void cpu_tiled_to(const TiledMatrix* m, dtype_t* dst, GemmLayout layout) {
+	uint32_t tile = m->tile, rows = m->rows, cols = m->cols;
+	for(uint32_t ti = 0; ti < m->tile_rows; ti++) {
+		uint32_t I = MIN(tile, rows - ti * tile);
+		for(uint32_t tj = 0; tj < m->tile_cols; tj++) {
+			uint32_t J = MIN(tile, cols - tj * tile);
+			const dtype_t* t = cpu_tiled_tile(m, ti, tj);
+			if(layout == GEMM_ROW_MAJOR) {
+				dtype_t* d = &dst[(size_t)ti * tile * cols + tj * tile];
+				for(uint32_t i = 0; i < I; i++) memcpy(&d[(size_t)i * cols], &t[i * tile], J * sizeof(dtype_t));
+			} else {
+				dtype_t* d = &dst[(size_t)tj * tile * rows + ti * tile];
+				for(uint32_t j = 0; j < J; j++) {
+					for(uint32_t i = 0; i < I; i++) d[(size_t)j * rows + i] = t[i * tile + j];
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "cpu/cpu_tune.h"
+#include "cpu/cpu_gemm.h"
+#include "cpu/cpu_cache.h"
+#include "cpu/cpu_context.h"
+#include "cpu/cpu_alloc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+
+#define MAX_TUNED_BLOCKSIZE 1024
+#define MAX_TUNED_MC 4096
+#define MAX_TUNED_KC 2048
+#define MAX_TUNED_NC 16384
+
+// runs per shape (the fastest one counts) and how much faster a candidate has
+// to be to replace the current value, so noise doesn't move the parameters
+#define TUNE_REPS 3
+#define TUNE_MARGIN 0.02
+
+// mr and nr have to match the micro-kernels of src/cpu/cpu_gemm.c
+static GemmTuning tuning = {
+	.blocksize = 0,
+	.blis = {
+		{ "4x8_generic", 4, 8, 0, 0, 0, LOOP_ORDER_JR_IR, 4 },
+		{ "6x8_sse2", 6, 8, 0, 0, 0, LOOP_ORDER_JR_IR, 4 },
+		{ "6x16_avx", 6, 16, 0, 0, 0, LOOP_ORDER_JR_IR, 4 },
+		{ "14x32_avx512", 14, 32, 0, 0, 0, LOOP_ORDER_JR_IR, 4 },
+	},
+	// where the saved multiplication usually starts to pay for the extra
+	// additions and memory traffic, not searched by cpu_tune (too slow to time)
+	.strassen_cutoff = 1024,
+	.loaded = 0,
+};
+static int initialized = 0;
+
+// the entry point that runs each micro-kernel above, and the bound ISAs that
+// reach it through that entry point
+typedef struct {
+	CpuIsa min_isa;
+	CpuIsa max_isa;
+	GemmKernel kernel;
+} TunableKernel;
+
+static const TunableKernel tunable[N_BLIS_TUNINGS] = {
+	{ CPU_ISA_SCALAR, CPU_ISA_SCALAR, gemm_rrc },
+	{ CPU_ISA_SSE2, CPU_ISA_SSE2, gemm_rrc },
+	{ CPU_ISA_AVX2, CPU_ISA_AVX512, gemm_rrc_blis_avx },
+	{ CPU_ISA_AVX512, CPU_ISA_AVX512, gemm_rrc_blis_avx512 },
+};
+
+// representative (ni, nj, nk): square, tall-skinny, short-wide and deep
+typedef struct {
+	uint32_t ni;
+	uint32_t nj;
+	uint32_t nk;
+} Shape;
+
+static const Shape shapes[] = {
+	{ 256, 256, 256 },
+	{ 768, 768, 768 },
+	{ 1536, 64, 512 },
+	{ 64, 1536, 512 },
+	{ 256, 256, 1536 },
+};
+#define N_SHAPES (sizeof(shapes) / sizeof(shapes[0]))
+
+static const char* loop_order_names[] = {
+	[LOOP_ORDER_JR_IR] = "jr_ir",
+	[LOOP_ORDER_IR_JR] = "ir_jr",
+};
+
+static const char* cpu_brand(void) {
+	static char brand[49] = "unknown";
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t regs[12];
+	if(__get_cpuid_max(0x80000000, NULL) >= 0x80000004) {
+		for(uint32_t i = 0; i < 3; i++) {
+			__cpuid(0x80000002 + i, regs[i * 4], regs[i * 4 + 1], regs[i * 4 + 2], regs[i * 4 + 3]);
+		}
+		memcpy(brand, regs, 48);
+		brand[48] = '\0';
+	}
+#endif
+	// some vendors pad the brand string on the left
+	char* start = brand;
+	while(*start == ' ') {
+		start++;
+	}
+	return start;
+}
+
+static void sanitize_blis(BlisTuning* t) {
+	// the packing buffers hold whole micro-panels, so MC and NC have to be
+	// multiples of MR and NR
+	t->mc = MAX(t->mr, MIN(MAX_TUNED_MC, t->mc) / t->mr * t->mr);
+	t->kc = MAX(1, MIN(MAX_TUNED_KC, t->kc));
+	t->nc = MAX(t->nr, MIN(MAX_TUNED_NC, t->nc) / t->nr * t->nr);
+	if(t->order != LOOP_ORDER_IR_JR) {
+		t->order = LOOP_ORDER_JR_IR;
+	}
+	t->unroll = t->unroll >= 4 ? 4 : t->unroll >= 2 ? 2 : 1;
+}
+
+GemmTuning* cpu_tuning(void) {
+	if(initialized) {
+		return &tuning;
+	}
+	initialized = 1;
+	tuning.blocksize = cpu_square_blocking(sizeof(dtype_t));
+	for(uint32_t i = 0; i < N_BLIS_TUNINGS; i++) {
+		BlisTuning* t = &tuning.blis[i];
+		BlisBlocking blocking = cpu_blis_blocking(t->mr, t->nr, sizeof(dtype_t));
+		t->mc = blocking.mc;
+		t->kc = blocking.kc;
+		t->nc = blocking.nc;
+	}
+	const char* path = cpu_tuning_path();
+	if(path) {
+		cpu_tuning_load(path);
+	}
+	return &tuning;
+}
+
+int cpu_tuning_blis(const char* name) {
+	GemmTuning* t = cpu_tuning();
+	for(uint32_t i = 0; i < N_BLIS_TUNINGS; i++) {
+		if(!strcmp(t->blis[i].name, name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+const char* cpu_tuning_path(void) {
+	static char path[4096];
+	const char* env = getenv("GEMM_TUNING_FILE");
+	if(env) {
+		return *env ? env : NULL;
+	}
+	const char* home = getenv("HOME");
+	if(!home) {
+		return NULL;
+	}
+	snprintf(path, sizeof(path), "%s/.gemm_tuning", home);
+	return path;
+}
+
+int cpu_tuning_load(const char* path) {
+	FILE* f = fopen(path, "r");
+	if(!f) {
+		return 1;
+	}
+	GemmTuning loaded = tuning;
+	int cpu_matches = 0;
+	char line[256];
+	while(fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\n")] = '\0';
+		if(line[0] == '#' || line[0] == '\0') {
+			continue;
+		}
+		if(!strncmp(line, "cpu ", 4)) {
+			cpu_matches = !strcmp(line + 4, cpu_brand());
+			if(!cpu_matches) {
+				break;
+			}
+			continue;
+		}
+		// values before the cpu line can't be trusted either
+		if(!cpu_matches) {
+			break;
+		}
+		unsigned int blocksize, cutoff;
+		char name[32], order[8];
+		unsigned int mr, nr, mc, kc, nc, unroll;
+		if(sscanf(line, "blocksize %u", &blocksize) == 1) {
+			loaded.blocksize = MAX(16, MIN(MAX_TUNED_BLOCKSIZE, blocksize));
+		} else if(sscanf(line, "strassen_cutoff %u", &cutoff) == 1) {
+			loaded.strassen_cutoff = MAX(16, cutoff);
+		} else if(sscanf(line, "blis %31s %u %u %u %u %u %7s %u", name, &mr, &nr, &mc, &kc, &nc, order, &unroll) == 8) {
+			for(uint32_t i = 0; i < N_BLIS_TUNINGS; i++) {
+				BlisTuning* t = &loaded.blis[i];
+				// entries of micro-kernels that changed shape are stale
+				if(strcmp(t->name, name) || t->mr != mr || t->nr != nr) {
+					continue;
+				}
+				t->mc = mc;
+				t->kc = kc;
+				t->nc = nc;
+				t->order = strcmp(order, loop_order_names[LOOP_ORDER_IR_JR]) ? LOOP_ORDER_JR_IR : LOOP_ORDER_IR_JR;
+				t->unroll = unroll;
+				sanitize_blis(t);
+			}
+		}
+	}
+	fclose(f);
+	if(!cpu_matches) {
+		return 1;
+	}
+	loaded.loaded = 1;
+	tuning = loaded;
+	return 0;
+}
+
+int cpu_tuning_save(const char* path) {
+	FILE* f = fopen(path, "w");
+	if(!f) {
+		return 1;
+	}
+	fprintf(f, "# written by `gemm --tune`, delete it to go back to the analytical block sizes\n");
+	fprintf(f, "# blis <micro-kernel> <mr> <nr> <mc> <kc> <nc> <jr_ir|ir_jr> <k unroll>\n");
+	fprintf(f, "cpu %s\n", cpu_brand());
+	fprintf(f, "blocksize %u\n", tuning.blocksize);
+	fprintf(f, "strassen_cutoff %u\n", tuning.strassen_cutoff);
+	for(uint32_t i = 0; i < N_BLIS_TUNINGS; i++) {
+		BlisTuning* t = &tuning.blis[i];
+		fprintf(f, "blis %s %u %u %u %u %u %s %u\n", t->name, t->mr, t->nr, t->mc, t->kc, t->nc, loop_order_names[t->order], t->unroll);
+	}
+	return fclose(f) ? 1 : 0;
+}
+
+// operands of the timed calls, and a context so the timings don't include
+// allocating the packing buffers
+typedef struct {
+	dtype_t* C;
+	dtype_t* A;
+	dtype_t* B;
+	GemmContext* ctx;
+} Workspace;
+
+// geometric mean of the GFLOP/s over the shapes
+static double score(GemmKernel f, Workspace* w) {
+	double log_sum = 0;
+	for(uint32_t s = 0; s < N_SHAPES; s++) {
+		const Shape* shape = &shapes[s];
+		// warm up caches and page tables first
+		f(w->ctx, w->C, w->A, w->B, shape->ni, shape->nj, shape->nk);
+		double best = INFINITY;
+		for(uint32_t r = 0; r < TUNE_REPS; r++) {
+			double start = omp_get_wtime();
+			f(w->ctx, w->C, w->A, w->B, shape->ni, shape->nj, shape->nk);
+			best = MIN(best, omp_get_wtime() - start);
+		}
+		log_sum += log(2.0 * shape->ni * shape->nj * shape->nk / best / 1e9);
+	}
+	return exp(log_sum / N_SHAPES);
+}
+
+static void log_blis(FILE* log, const BlisTuning* t, double gflops) {
+	fprintf(log, "\t[%s] mc %u kc %u nc %u %s unroll %u: %.1f GFLOP/s\n", t->name, t->mc, t->kc, t->nc, loop_order_names[t->order], t->unroll, gflops);
+}
+
+// times the candidate and keeps it in *t only if it beats *best
+static void try_blis(BlisTuning* t, BlisTuning candidate, GemmKernel f, Workspace* w, double* best, FILE* log) {
+	sanitize_blis(&candidate);
+	if(candidate.mc == t->mc && candidate.kc == t->kc && candidate.nc == t->nc &&
+		candidate.order == t->order && candidate.unroll == t->unroll) {
+		return;
+	}
+	BlisTuning current = *t;
+	*t = candidate;
+	double gflops = score(f, w);
+	log_blis(log, t, gflops);
+	if(gflops > *best * (1 + TUNE_MARGIN)) {
+		*best = gflops;
+	} else {
+		*t = current;
+	}
+}
+
+// coordinate search starting from the current values: loop order and unroll
+// first, then KC, MC and NC scaled around their current value
+static void tune_blis(BlisTuning* t, GemmKernel f, Workspace* w, FILE* log) {
+	static const uint32_t unrolls[] = { 1, 2, 4 };
+	static const double scales[] = { 0.25, 0.5, 0.75, 1.25, 1.5, 2 };
+	double best = score(f, w);
+	log_blis(log, t, best);
+	for(uint32_t o = LOOP_ORDER_JR_IR; o <= LOOP_ORDER_IR_JR; o++) {
+		for(uint32_t u = 0; u < sizeof(unrolls) / sizeof(unrolls[0]); u++) {
+			BlisTuning candidate = *t;
+			candidate.order = (LoopOrder)o;
+			candidate.unroll = unrolls[u];
+			try_blis(t, candidate, f, w, &best, log);
+		}
+	}
+	uint32_t kc = t->kc;
+	for(uint32_t s = 0; s < sizeof(scales) / sizeof(scales[0]); s++) {
+		BlisTuning candidate = *t;
+		// multiple of 8 keeps the packed panels aligned like the analytical KC
+		candidate.kc = MAX(8, (uint32_t)(kc * scales[s]) / 8 * 8);
+		try_blis(t, candidate, f, w, &best, log);
+	}
+	uint32_t mc = t->mc;
+	for(uint32_t s = 0; s < sizeof(scales) / sizeof(scales[0]); s++) {
+		BlisTuning candidate = *t;
+		candidate.mc = (uint32_t)(mc * scales[s]);
+		try_blis(t, candidate, f, w, &best, log);
+	}
+	uint32_t nc = t->nc;
+	for(uint32_t s = 0; s < sizeof(scales) / sizeof(scales[0]); s++) {
+		BlisTuning candidate = *t;
+		candidate.nc = (uint32_t)(nc * scales[s]);
+		try_blis(t, candidate, f, w, &best, log);
+	}
+	fprintf(log, "\t[%s] picked:\n", t->name);
+	log_blis(log, t, best);
+}
+
+static void tune_blocksize(GemmTuning* t, Workspace* w, FILE* log) {
+	double best = score(gemm_rrc_blocked_avx, w);
+	fprintf(log, "\t[blocked] blocksize %u: %.1f GFLOP/s\n", t->blocksize, best);
+	uint32_t current = t->blocksize;
+	uint32_t picked = current;
+	for(uint32_t blocksize = 32; blocksize <= 256; blocksize += 32) {
+		if(blocksize == current) {
+			continue;
+		}
+		t->blocksize = blocksize;
+		double gflops = score(gemm_rrc_blocked_avx, w);
+		fprintf(log, "\t[blocked] blocksize %u: %.1f GFLOP/s\n", blocksize, gflops);
+		if(gflops > best * (1 + TUNE_MARGIN)) {
+			best = gflops;
+			picked = blocksize;
+		}
+	}
+	t->blocksize = picked;
+	fprintf(log, "\t[blocked] picked blocksize %u\n", picked);
+}
+
+int cpu_tune(const char* path, FILE* log) {
+	GemmTuning* t = cpu_tuning();
+	uint32_t size_c = 0, size_a = 0, size_b = 0;
+	for(uint32_t s = 0; s < N_SHAPES; s++) {
+		size_c = MAX(size_c, shapes[s].ni * shapes[s].nj);
+		size_a = MAX(size_a, shapes[s].ni * shapes[s].nk);
+		size_b = MAX(size_b, shapes[s].nk * shapes[s].nj);
+	}
+	Workspace w = {
+		.C = cpu_calloc(size_c, sizeof(dtype_t)),
+		.A = cpu_alloc(size_a * sizeof(dtype_t)),
+		.B = cpu_alloc(size_b * sizeof(dtype_t)),
+		.ctx = cpu_context_create(0),
+	};
+	if(!w.C || !w.A || !w.B || !w.ctx) {
+		fprintf(log, "out of memory for the tuning operands\n");
+		cpu_free(w.C);
+		cpu_free(w.A);
+		cpu_free(w.B);
+		cpu_context_destroy(w.ctx);
+		return 1;
+	}
+	for(uint32_t i = 0; i < size_a; i++) {
+		w.A[i] = rand() & 1 ? 0.5 : 1;
+	}
+	for(uint32_t i = 0; i < size_b; i++) {
+		w.B[i] = rand() & 1 ? 0.5 : 1;
+	}
+
+	CpuIsa isa = cpu_isa();
+	fprintf(log, "tuning the %s kernels on %s\n", cpu_isa_name(isa), cpu_brand());
+	tune_blocksize(t, &w, log);
+	for(uint32_t i = 0; i < N_BLIS_TUNINGS; i++) {
+		if(isa >= tunable[i].min_isa && isa <= tunable[i].max_isa) {
+			tune_blis(&t->blis[i], tunable[i].kernel, &w, log);
+		}
+	}
+	cpu_free(w.C);
+	cpu_free(w.A);
+	cpu_free(w.B);
+	cpu_context_destroy(w.ctx);
+
+	if(!path) {
+		return 0;
+	}
+	if(cpu_tuning_save(path)) {
+		fprintf(log, "could not write %s\n", path);
+		return 1;
+	}
+	t->loaded = 1;
+	fprintf(log, "saved to %s\n", path);
+	return 0;
+}
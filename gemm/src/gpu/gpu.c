@@ -52,7 +52,13 @@ GPUData initGPUData(void) {
 	};
 	signal = 1;
 
-	const WGPUDeviceDescriptor desc = {0};
+	// ask for everything the adapter supports, the default limits would cap
+	// workgroups at 256 invocations and 16 KB of shared memory
+	WGPULimits limits = {0};
+	int has_limits = wgpuAdapterGetLimits(adapter, &limits) == WGPUStatus_Success;
+	const WGPUDeviceDescriptor desc = {
+		.requiredLimits = has_limits ? &limits : NULL,
+	};
 	WGPURequestDeviceCallbackInfo device_callback_info = {
 		.callback = onDeviceRequest,
 		.userdata1 = &device,
@@ -66,6 +72,20 @@ GPUData initGPUData(void) {
 
 	queue = wgpuDeviceGetQueue(device);
 
+	// largest power of two tile (up to 32x32) that fits the workgroup
+	// invocation and shared memory limits of the device
+	uint32_t blocksize = 16;
+	if(wgpuDeviceGetLimits(device, &limits) == WGPUStatus_Success) {
+		blocksize = 32;
+		while(blocksize > 1 && (
+			blocksize * blocksize > limits.maxComputeInvocationsPerWorkgroup ||
+			blocksize > limits.maxComputeWorkgroupSizeX ||
+			blocksize > limits.maxComputeWorkgroupSizeY ||
+			2 * blocksize * blocksize * sizeof(float) > limits.maxComputeWorkgroupStorageSize)) {
+			blocksize /= 2;
+		}
+	}
+
 	printf("Device and queue are ready!\n");
 
 	GPUData data = {
@@ -73,6 +93,7 @@ GPUData initGPUData(void) {
 		.adapter = adapter,
 		.instance = instance,
 		.queue = queue,
+		.blocksize = blocksize,
 	};
 	return data;
 }
@@ -11,10 +11,6 @@ typedef struct {
 	int* signal;
 } ReadbackData;
 
-#define BLOCKSIZE 16
-#define _QUOTE(arg) #arg
-#define STR(arg) _QUOTE(arg)
-#define BLOCKSIZE_STR STR(BLOCKSIZE)
 
 void onBufferMapped(WGPUMapAsyncStatus status, WGPUStringView message, void* userdata1, void* _) {
 	ReadbackData* data = (ReadbackData*)userdata1;
@@ -84,22 +80,25 @@ void gemm_gpu(GPUData* gpu, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uin
 	wgpuQueueWriteBuffer(gpu->queue, dims_buf, 0, dims_data, sizeof(dims_data));
 
 	// https://webgpufundamentals.org/webgpu/lessons/webgpu-compute-shaders.html
-	const char* wgsl_code = 
+	// the tile side comes from the device limits (see initGPUData)
+	char wgsl_code[2048];
+	uint32_t bs = gpu->blocksize;
+	snprintf(wgsl_code, sizeof(wgsl_code),
 		"struct Dims { ni: u32, nj: u32, nk: u32, pad: u32, };\n"
 		"@group(0) @binding(0) var<storage, read> A: array<f32>;\n"
 		"@group(0) @binding(1) var<storage, read> B: array<f32>;\n"
 		"@group(0) @binding(2) var<storage, read_write> C: array<f32>;\n"
 		"@group(0) @binding(3) var<uniform> dims: Dims;\n"
-		"var<workgroup> block_a: array<array<f32, " BLOCKSIZE_STR ">, " BLOCKSIZE_STR ">;\n"
-		"var<workgroup> block_b: array<array<f32, " BLOCKSIZE_STR ">, " BLOCKSIZE_STR ">;\n"
-		"@compute @workgroup_size(" BLOCKSIZE_STR ", " BLOCKSIZE_STR ")\n"
+		"var<workgroup> block_a: array<array<f32, %u>, %u>;\n"
+		"var<workgroup> block_b: array<array<f32, %u>, %u>;\n"
+		"@compute @workgroup_size(%u, %u)\n"
 		"fn main(@builtin(global_invocation_id) gid: vec3<u32>, @builtin(local_invocation_id) lid: vec3<u32>) {\n" 
 		"  var acc: f32 = 0.0;\n"
-		"  for(var b = 0u; b < dims.nk; b += " BLOCKSIZE_STR ") {\n"
+		"  for(var b = 0u; b < dims.nk; b += %u) {\n"
 		// load in shared (workgroup) memory
 		"    block_a[lid.y][lid.x] = A[gid.y * dims.nk + b + lid.x];\n"
 		"    block_b[lid.y][lid.x] = B[(b + lid.y) + gid.x * dims.nk];\n"
-		"    var K = min(dims.nk - b, " BLOCKSIZE_STR ");\n"
+		"    var K = min(dims.nk - b, %u);\n"
 		"    workgroupBarrier();\n"
 		// compute using tiles
 		"    for(var k = 0u; k < K; k++) {\n"
@@ -108,7 +107,7 @@ void gemm_gpu(GPUData* gpu, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uin
 		"    workgroupBarrier();\n"
 		"  }\n"
 		"  C[gid.y * dims.nj + gid.x] += acc;\n"
-		"}\n";
+		"}\n", bs, bs, bs, bs, bs, bs, bs, bs);
 
 	WGPUShaderModule shader = wgpuDeviceCreateShaderModule(
 		gpu->device,
@@ -193,8 +192,8 @@ void gemm_gpu(GPUData* gpu, dtype_t* C, dtype_t* A, dtype_t* B, uint32_t ni, uin
 	);
 	wgpuComputePassEncoderSetPipeline(compute_pass_encoder, compute_pipeline);
 	wgpuComputePassEncoderSetBindGroup(compute_pass_encoder, 0, bind_group, 0, NULL);
-	uint32_t groups_x = (nj + BLOCKSIZE - 1) / BLOCKSIZE;
-	uint32_t groups_y = (ni + BLOCKSIZE - 1) / BLOCKSIZE;
+	uint32_t groups_x = (nj + gpu->blocksize - 1) / gpu->blocksize;
+	uint32_t groups_y = (ni + gpu->blocksize - 1) / gpu->blocksize;
 	wgpuComputePassEncoderDispatchWorkgroups(compute_pass_encoder, groups_x, groups_y, 1);
 	wgpuComputePassEncoderEnd(compute_pass_encoder);
 	wgpuComputePassEncoderRelease(compute_pass_encoder);
@@ -0,0 +1,73 @@
+// setenv
+#define _GNU_SOURCE
+#include "cpu/cpu_gemm.h"
+#include "cpu/cpu_context.h"
+#include "cpu/cpu_alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 256
+#define ITERATIONS 4
+
+// operands freed and allocated again between calls, as a program unaware of
+// the pack cache would do: the allocator hands the same addresses back, and
+// with A filled with it + 1 and B with ones every element of C is (it + 1) N.
+// bump_epoch follows the contract of cpu_context_set_pack_cache
+static int reallocated_operands(GemmContext* ctx, int bump_epoch) {
+	for(uint32_t it = 0; it < ITERATIONS; it++) {
+		dtype_t* A = cpu_alloc(N * N * sizeof(dtype_t));
+		dtype_t* B = cpu_alloc(N * N * sizeof(dtype_t));
+		dtype_t* C = cpu_calloc(N * N, sizeof(dtype_t));
+		if(!A || !B || !C) {
+			cpu_free(A), cpu_free(B), cpu_free(C);
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		for(uint32_t i = 0; i < N * N; i++) {
+			A[i] = it + 1;
+			B[i] = 1;
+		}
+		if(bump_epoch) {
+			ctx->epoch++;
+		}
+		gemm_rrc(ctx, C, A, B, N, N, N);
+		int failed = 0;
+		for(uint32_t i = 0; i < N * N && !failed; i++) {
+			failed = C[i] != (dtype_t)((it + 1) * N);
+		}
+		if(failed) {
+			fprintf(stderr, "iteration %u: C[0] = %g instead of %g\n", it, C[0], (double)((it + 1) * N));
+		}
+		cpu_free(A), cpu_free(B), cpu_free(C);
+		if(failed) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// the pack cache is off unless the caller gives it a budget, whatever the
+// environment says
+static int test_pack_cache_reallocated_operands(void) {
+	setenv("GEMM_PACK_CACHE", "64", 1);
+	GemmContext* ctx = cpu_context_create(0);
+	if(!ctx) {
+		return 1;
+	}
+	int failed = ctx->pack_cache.budget != 0 || reallocated_operands(ctx, 0);
+	cpu_context_set_pack_cache(ctx, 64 << 20);
+	failed = failed || reallocated_operands(ctx, 1);
+	cpu_context_destroy(ctx);
+	unsetenv("GEMM_PACK_CACHE");
+	return failed;
+}
+
+int main(void) {
+	int failed = 0;
+	if(test_pack_cache_reallocated_operands()) {
+		printf("FAILED: pack cache with reallocated operands\n");
+		failed = 1;
+	}
+	printf(failed ? "tests failed\n" : "all tests passed\n");
+	return failed;
+}